@@ -0,0 +1,242 @@
+#include "event_loop.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+    const size_t READ_CHUNK_SIZE = 64 << 10;
+    // A client that sends more than this without a newline is answered with an error and dropped
+    const size_t MAX_LINE_SIZE = 1 << 20;
+    const int MAX_EVENTS = 256;
+
+    void SetNonBlocking(int fd) {
+        const int flags = ::fcntl(fd, F_GETFL, 0);
+        if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+            throw std::runtime_error("Failed to make a socket non-blocking"s);
+        }
+    }
+
+    int ListenOn(int fd, const sockaddr* address, socklen_t address_size) {
+        if (::bind(fd, address, address_size) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+            const std::string error = std::strerror(errno);
+            ::close(fd);
+            throw std::runtime_error("Failed to listen: "s + error);
+        }
+        SetNonBlocking(fd);
+        return fd;
+    }
+}
+
+int ListenTcp(int port) {
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create a socket"s);
+    }
+    const int enable = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return ListenOn(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+}
+
+int ListenUnix(const std::string& path) {
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create a socket"s);
+    }
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        ::close(fd);
+        throw std::runtime_error("The socket path is too long"s);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    ::unlink(path.c_str());
+    return ListenOn(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+}
+
+EventLoop::EventLoop(RequestHandler& request_handler, int listen_fd, size_t output_limit)
+    : request_handler_(request_handler), listen_fd_(listen_fd), output_limit_(output_limit)
+{
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    stop_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || stop_fd_ < 0) {
+        throw std::runtime_error("Failed to create the event loop"s);
+    }
+    for (const int fd : { listen_fd_, stop_fd_ }) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+EventLoop::~EventLoop() {
+    for (const auto& [fd, _] : connections_) {
+        ::close(fd);
+    }
+    ::close(stop_fd_);
+    ::close(epoll_fd_);
+}
+
+void EventLoop::Run() {
+    std::vector<epoll_event> events(MAX_EVENTS);
+    while (true) {
+        const int ready = ::epoll_wait(epoll_fd_, events.data(), MAX_EVENTS, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("epoll_wait failed"s);
+        }
+        for (int i = 0; i < ready; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == stop_fd_) {
+                return;
+            }
+            if (fd == listen_fd_) {
+                Accept();
+                continue;
+            }
+            const auto connection_it = connections_.find(fd);
+            if (connection_it == connections_.end()) {
+                continue;
+            }
+            Connection& connection = connection_it->second;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                connection.closing = true;
+                connection.reading = false;
+            }
+            if (events[i].events & EPOLLOUT) {
+                Write(fd, connection);
+            }
+            if ((events[i].events & EPOLLIN) && connection.reading) {
+                Read(fd, connection);
+            }
+            if (connection.closing && connection.output_sent == connection.output.size()) {
+                Close(fd);
+                continue;
+            }
+            UpdateEvents(fd, connection);
+        }
+    }
+}
+
+void EventLoop::Stop() {
+    const uint64_t value = 1;
+    [[maybe_unused]] const ssize_t written = ::write(stop_fd_, &value, sizeof(value));
+}
+
+void EventLoop::Accept() {
+    while (true) {
+        const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        const int enable = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        connections_.emplace(fd, Connection{});
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void EventLoop::Read(int fd, Connection& connection) {
+    char buffer[READ_CHUNK_SIZE];
+    while (connection.output.size() - connection.output_sent < output_limit_) {
+        const ssize_t received = ::read(fd, buffer, sizeof(buffer));
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            connection.closing = true;
+            connection.reading = false;
+            break;
+        }
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        connection.input.append(buffer, static_cast<size_t>(received));
+
+        // Every complete line is a request, the pipelined ones are handled as one batch
+        std::vector<std::string_view> lines;
+        std::string_view pending = connection.input;
+        for (size_t line_end = pending.find('\n'); line_end != pending.npos; line_end = pending.find('\n')) {
+            std::string_view line = pending.substr(0, line_end);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            lines.push_back(line);
+            pending.remove_prefix(line_end + 1);
+        }
+        if (!lines.empty()) {
+            request_handler_.HandleRequests(lines, connection.output);
+            connection.input.erase(0, connection.input.size() - pending.size());
+        }
+        if (connection.input.size() > MAX_LINE_SIZE) {
+            connection.output += "ERR line too long\n"s;
+            connection.input.clear();
+            connection.closing = true;
+            break;
+        }
+    }
+    // Back-pressure: the socket is left unread until the output drains
+    connection.reading = !connection.closing && connection.output.size() - connection.output_sent < output_limit_;
+    Write(fd, connection);
+}
+
+void EventLoop::Write(int fd, Connection& connection) {
+    while (connection.output_sent < connection.output.size()) {
+        const ssize_t sent = ::send(fd, connection.output.data() + connection.output_sent,
+            connection.output.size() - connection.output_sent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                connection.closing = true;
+                connection.reading = false;
+                connection.output_sent = connection.output.size();
+            }
+            break;
+        }
+        connection.output_sent += static_cast<size_t>(sent);
+    }
+    if (connection.output_sent == connection.output.size()) {
+        connection.output.clear();
+        connection.output_sent = 0;
+    }
+    if (!connection.closing) {
+        connection.reading = connection.output.size() - connection.output_sent < output_limit_;
+    }
+}
+
+void EventLoop::UpdateEvents(int fd, const Connection& connection) {
+    epoll_event event{};
+    event.events = (connection.reading ? uint32_t{EPOLLIN} : 0u) | (connection.output_sent < connection.output.size() ? uint32_t{EPOLLOUT} : 0u);
+    event.data.fd = fd;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event);
+}
+
+void EventLoop::Close(int fd) {
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections_.erase(fd);
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <map>
+#include <string>
+#include "request_handler.h"
+
+// Single-threaded epoll loop over non-blocking sockets. Every read may carry many pipelined
+// requests; all complete lines are handled together and answered in order. A connection whose
+// unsent responses exceed the output limit is not read from until the client catches up.
+class EventLoop {
+public:
+    EventLoop(RequestHandler& request_handler, int listen_fd, size_t output_limit = 4 << 20);
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    ~EventLoop();
+
+    // Serves connections until Stop() is called
+    void Run();
+
+    void Stop();
+
+private:
+    struct Connection {
+        std::string input;
+        std::string output;
+        size_t output_sent = 0;
+        bool reading = true;
+        bool closing = false;
+    };
+
+    void Accept();
+    void Read(int fd, Connection& connection);
+    void Write(int fd, Connection& connection);
+    void UpdateEvents(int fd, const Connection& connection);
+    void Close(int fd);
+
+    RequestHandler& request_handler_;
+    const int listen_fd_;
+    const size_t output_limit_;
+    int epoll_fd_ = -1;
+    int stop_fd_ = -1;
+    std::map<int, Connection> connections_;
+};
+
+// Both return a non-blocking listening socket and throw std::runtime_error on failure
+int ListenTcp(int port);
+int ListenUnix(const std::string& path);
@@ -0,0 +1,79 @@
+#include "event_loop.h"
+#include "../search-server/corpus_loader.h"
+
+#include <csignal>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+    EventLoop* running_loop = nullptr;
+
+    void HandleSignal(int) {
+        if (running_loop) {
+            running_loop->Stop();
+        }
+    }
+
+    void PrintUsage() {
+        cerr << "Usage: query_frontend (--port <port> | --unix <path>) [--stop-words \"<words>\"] [--corpus <file.tsv>] [--batch <size>]"s << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int port = -1;
+    string unix_path;
+    string stop_words;
+    string corpus_path;
+    size_t max_batch_size = 256;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const string option = argv[i];
+        const string value = argv[i + 1];
+        if (option == "--port"s) {
+            port = stoi(value);
+        }
+        else if (option == "--unix"s) {
+            unix_path = value;
+        }
+        else if (option == "--stop-words"s) {
+            stop_words = value;
+        }
+        else if (option == "--corpus"s) {
+            corpus_path = value;
+        }
+        else if (option == "--batch"s) {
+            max_batch_size = stoul(value);
+        }
+        else {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if ((port < 0) == unix_path.empty()) {
+        PrintUsage();
+        return 1;
+    }
+
+    try {
+        SearchServer search_server(stop_words);
+        if (!corpus_path.empty()) {
+            cerr << "Loaded "s << LoadCorpus(corpus_path, search_server) << " documents"s << endl;
+        }
+
+        RequestHandler request_handler(search_server, max_batch_size);
+        EventLoop loop(request_handler, port >= 0 ? ListenTcp(port) : ListenUnix(unix_path));
+        running_loop = &loop;
+        signal(SIGINT, HandleSignal);
+        signal(SIGTERM, HandleSignal);
+        loop.Run();
+        running_loop = nullptr;
+    }
+    catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
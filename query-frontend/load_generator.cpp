@@ -0,0 +1,255 @@
+#include "../search-server/metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Drives query_frontend with pipelined SEARCH requests over several connections and reports
+// throughput and latency percentiles. With --documents it first adds synthetic documents.
+namespace {
+
+    using Clock = chrono::steady_clock;
+
+    struct Options {
+        int port = -1;
+        string unix_path;
+        size_t connections = 4;
+        size_t depth = 16;
+        size_t requests = 100000;
+        size_t documents = 0;
+        size_t vocabulary = 1000;
+    };
+
+    int Connect(const Options& options) {
+        int fd = -1;
+        if (options.port >= 0) {
+            fd = socket(AF_INET, SOCK_STREAM, 0);
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(static_cast<uint16_t>(options.port));
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+                throw runtime_error("Failed to connect"s);
+            }
+            const int enable = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        }
+        else {
+            fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            strncpy(address.sun_path, options.unix_path.c_str(), sizeof(address.sun_path) - 1);
+            if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+                throw runtime_error("Failed to connect"s);
+            }
+        }
+        return fd;
+    }
+
+    void SendAll(int fd, const string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            const ssize_t result = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (result <= 0) {
+                throw runtime_error("Failed to send"s);
+            }
+            sent += static_cast<size_t>(result);
+        }
+    }
+
+    // Reads until count response lines arrived, returns how many of them were errors
+    size_t ReceiveLines(int fd, string& buffer, size_t count) {
+        size_t errors = 0;
+        char chunk[64 << 10];
+        while (count > 0) {
+            size_t line_end = buffer.find('\n');
+            while (line_end != string::npos && count > 0) {
+                errors += buffer.compare(0, 3, "ERR") == 0;
+                buffer.erase(0, line_end + 1);
+                --count;
+                line_end = buffer.find('\n');
+            }
+            if (count == 0) {
+                break;
+            }
+            const ssize_t received = recv(fd, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                throw runtime_error("The connection was closed"s);
+            }
+            buffer.append(chunk, static_cast<size_t>(received));
+        }
+        return errors;
+    }
+
+    string MakeWord(mt19937& generator, size_t vocabulary) {
+        return "w"s + to_string(generator() % vocabulary);
+    }
+
+    void AddDocuments(const Options& options) {
+        const int fd = Connect(options);
+        mt19937 generator(42);
+        string buffer;
+        const size_t batch_size = 1000;
+        for (size_t begin = 0; begin < options.documents; begin += batch_size) {
+            const size_t end = min(options.documents, begin + batch_size);
+            string requests;
+            for (size_t id = begin; id < end; ++id) {
+                requests += "ADD "s + to_string(id) + " ACTUAL "s + to_string(generator() % 10) + " "s;
+                const size_t word_count = 5 + generator() % 20;
+                for (size_t i = 0; i < word_count; ++i) {
+                    requests += MakeWord(generator, options.vocabulary) + ' ';
+                }
+                requests += '\n';
+            }
+            SendAll(fd, requests);
+            ReceiveLines(fd, buffer, end - begin);
+        }
+        close(fd);
+    }
+
+    struct WorkerResult {
+        LatencyHistogram histogram;
+        uint64_t max_ns = 0;
+        size_t errors = 0;
+        // Set when the connection failed, an exception must not leave a std::thread
+        string failure;
+    };
+
+    // Keeps depth requests in flight, latency is measured from send to the matching response
+    void SendRequests(int fd, const Options& options, size_t request_count, unsigned seed, WorkerResult& result) {
+        mt19937 generator(seed);
+        deque<Clock::time_point> in_flight;
+        string buffer;
+        size_t sent = 0;
+        size_t received = 0;
+        while (received < request_count) {
+            string requests;
+            while (sent < request_count && in_flight.size() < options.depth) {
+                requests += "SEARCH "s + MakeWord(generator, options.vocabulary) + ' ' + MakeWord(generator, options.vocabulary)
+                    + " -"s + MakeWord(generator, options.vocabulary) + '\n';
+                in_flight.push_back(Clock::now());
+                ++sent;
+            }
+            if (!requests.empty()) {
+                SendAll(fd, requests);
+            }
+            result.errors += ReceiveLines(fd, buffer, 1);
+            const uint64_t latency = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - in_flight.front()).count();
+            in_flight.pop_front();
+            result.histogram.Add(LatencyHistogram::GetBucketIndex(latency), 1);
+            result.max_ns = max(result.max_ns, latency);
+            ++received;
+        }
+    }
+
+    void RunConnection(const Options& options, size_t request_count, unsigned seed, WorkerResult& result) {
+        int fd = -1;
+        try {
+            fd = Connect(options);
+            SendRequests(fd, options, request_count, seed, result);
+        }
+        catch (const exception& e) {
+            result.failure = e.what();
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const string option = argv[i];
+        const string value = argv[i + 1];
+        if (option == "--port"s) {
+            options.port = stoi(value);
+        }
+        else if (option == "--unix"s) {
+            options.unix_path = value;
+        }
+        else if (option == "--connections"s) {
+            options.connections = max<size_t>(1, stoul(value));
+        }
+        else if (option == "--depth"s) {
+            options.depth = max<size_t>(1, stoul(value));
+        }
+        else if (option == "--requests"s) {
+            options.requests = stoul(value);
+        }
+        else if (option == "--documents"s) {
+            options.documents = stoul(value);
+        }
+        else if (option == "--vocabulary"s) {
+            options.vocabulary = max<size_t>(1, stoul(value));
+        }
+        else {
+            cerr << "Unknown option "s << option << endl;
+            return 1;
+        }
+    }
+    if ((options.port < 0) == options.unix_path.empty()) {
+        cerr << "Usage: load_generator (--port <port> | --unix <path>) [--connections N] [--depth N] [--requests N] [--documents N] [--vocabulary N]"s << endl;
+        return 1;
+    }
+
+    try {
+        if (options.documents > 0) {
+            AddDocuments(options);
+        }
+
+        vector<WorkerResult> results(options.connections);
+        vector<thread> workers;
+        const auto start_time = Clock::now();
+        for (size_t i = 0; i < options.connections; ++i) {
+            const size_t request_count = options.requests / options.connections + (i < options.requests % options.connections ? 1 : 0);
+            workers.emplace_back(RunConnection, cref(options), request_count, static_cast<unsigned>(i + 1), ref(results[i]));
+        }
+        for (thread& worker : workers) {
+            worker.join();
+        }
+        for (const WorkerResult& result : results) {
+            if (!result.failure.empty()) {
+                throw runtime_error(result.failure);
+            }
+        }
+        const double seconds = chrono::duration<double>(Clock::now() - start_time).count();
+
+        LatencyHistogram histogram;
+        uint64_t max_ns = 0;
+        size_t errors = 0;
+        for (const WorkerResult& result : results) {
+            histogram.Merge(result.histogram);
+            max_ns = max(max_ns, result.max_ns);
+            errors += result.errors;
+        }
+
+        cout << "requests = "s << options.requests << ", errors = "s << errors
+            << ", seconds = "s << seconds << ", requests/s = "s << options.requests / seconds << endl;
+        cout << "latency us: p50 = "s << histogram.GetValueAtPercentile(50) / 1000
+            << ", p90 = "s << histogram.GetValueAtPercentile(90) / 1000
+            << ", p99 = "s << histogram.GetValueAtPercentile(99) / 1000
+            << ", p999 = "s << histogram.GetValueAtPercentile(99.9) / 1000
+            << ", max = "s << max_ns / 1000 << endl;
+    }
+    catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
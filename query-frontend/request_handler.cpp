@@ -0,0 +1,209 @@
+#include "request_handler.h"
+#include "../search-server/process_queries.h"
+
+#include <charconv>
+
+namespace {
+
+    const std::string_view SEARCH_COMMAND = "SEARCH ";
+
+    std::string_view NextToken(std::string_view& line) {
+        line.remove_prefix(std::min(line.size(), line.find_first_not_of(' ')));
+        const size_t end = std::min(line.size(), line.find(' '));
+        std::string_view token = line.substr(0, end);
+        line.remove_prefix(end);
+        line.remove_prefix(std::min(line.size(), line.find_first_not_of(' ')));
+        return token;
+    }
+
+    int ParseInt(std::string_view text) {
+        int value = 0;
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (text.empty() || error != std::errc{} || end != text.data() + text.size()) {
+            throw std::invalid_argument("invalid number"s);
+        }
+        return value;
+    }
+
+    DocumentStatus ParseStatus(std::string_view text) {
+        if (text == "ACTUAL") {
+            return DocumentStatus::ACTUAL;
+        }
+        if (text == "IRRELEVANT") {
+            return DocumentStatus::IRRELEVANT;
+        }
+        if (text == "BANNED") {
+            return DocumentStatus::BANNED;
+        }
+        if (text == "REMOVED") {
+            return DocumentStatus::REMOVED;
+        }
+        throw std::invalid_argument("invalid status"s);
+    }
+
+    std::string_view GetStatusName(DocumentStatus status) {
+        switch (status) {
+        case DocumentStatus::ACTUAL:
+            return "ACTUAL";
+        case DocumentStatus::IRRELEVANT:
+            return "IRRELEVANT";
+        case DocumentStatus::BANNED:
+            return "BANNED";
+        default:
+            return "REMOVED";
+        }
+    }
+
+    std::vector<int> ParseRatings(std::string_view text) {
+        std::vector<int> ratings;
+        if (text == "-") {
+            return ratings;
+        }
+        while (!text.empty()) {
+            const size_t comma = std::min(text.size(), text.find(','));
+            ratings.push_back(ParseInt(text.substr(0, comma)));
+            text.remove_prefix(std::min(text.size(), comma + 1));
+        }
+        return ratings;
+    }
+
+    void AppendDocuments(const std::vector<Document>& documents, std::string& out) {
+        out += "OK "s;
+        out += std::to_string(documents.size());
+        for (const Document& document : documents) {
+            out += ' ';
+            out += std::to_string(document.id);
+            out += ' ';
+            out += std::to_string(document.relevance);
+            out += ' ';
+            out += std::to_string(document.rating);
+        }
+        out += '\n';
+    }
+
+    void AppendError(std::string_view message, std::string& out) {
+        out += "ERR "s;
+        out += message;
+        out += '\n';
+    }
+}
+
+RequestHandler::RequestHandler(SearchServer& search_server, size_t max_batch_size)
+    : search_server_(search_server), max_batch_size_(std::max<size_t>(max_batch_size, 1))
+{
+}
+
+void RequestHandler::HandleRequests(const std::vector<std::string_view>& lines, std::string& out) {
+    std::vector<std::string_view> queries;
+    for (std::string_view line : lines) {
+        if (line.substr(0, SEARCH_COMMAND.size()) == SEARCH_COMMAND) {
+            queries.push_back(line.substr(SEARCH_COMMAND.size()));
+            if (queries.size() == max_batch_size_) {
+                HandleSearchBatch(queries, out);
+                queries.clear();
+            }
+            continue;
+        }
+        // Any other request may change the index, searches before it are answered first
+        HandleSearchBatch(queries, out);
+        queries.clear();
+        HandleRequest(line, out);
+    }
+    HandleSearchBatch(queries, out);
+}
+
+void RequestHandler::HandleSearchBatch(const std::vector<std::string_view>& queries, std::string& out) {
+    if (queries.empty()) {
+        return;
+    }
+    if (queries.size() == 1) {
+        HandleRequest(std::string(SEARCH_COMMAND) + std::string(queries.front()), out);
+        return;
+    }
+
+    // An invalid query would throw inside the parallel algorithm and terminate the process, reject it up front
+    std::vector<std::string> batch;
+    std::vector<size_t> batch_positions;
+    std::vector<std::string> responses(queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+        try {
+            search_server_.ValidateQuery(queries[i]);
+            batch.emplace_back(queries[i]);
+            batch_positions.push_back(i);
+        }
+        catch (const std::exception& e) {
+            AppendError(e.what(), responses[i]);
+        }
+    }
+
+    const std::vector<std::vector<Document>> results = ProcessQueries(search_server_, batch, statistics_);
+    for (size_t i = 0; i < results.size(); ++i) {
+        AppendDocuments(results[i], responses[batch_positions[i]]);
+    }
+    for (const std::string& response : responses) {
+        out += response;
+    }
+}
+
+void RequestHandler::HandleRequest(std::string_view line, std::string& out) {
+    try {
+        const std::string_view command = NextToken(line);
+        if (command == "SEARCH") {
+            const auto start_time = QueryStatistics::Clock::now();
+            const std::vector<Document> documents = search_server_.FindTopDocuments(line);
+            const auto end_time = QueryStatistics::Clock::now();
+            statistics_.Record(line, documents.size(), end_time - start_time, end_time);
+            AppendDocuments(documents, out);
+        }
+        else if (command == "STATS") {
+            HandleStats(out);
+        }
+        else if (command == "ADD") {
+            const int document_id = ParseInt(NextToken(line));
+            const DocumentStatus status = ParseStatus(NextToken(line));
+            const std::vector<int> ratings = ParseRatings(NextToken(line));
+            search_server_.AddDocument(document_id, line, status, ratings);
+            out += "OK\n"s;
+        }
+        else if (command == "REMOVE") {
+            search_server_.RemoveDocument(ParseInt(NextToken(line)));
+            out += "OK\n"s;
+        }
+        else if (command == "MATCH") {
+            const int document_id = ParseInt(NextToken(line));
+            const auto [words, status] = search_server_.MatchDocument(line, document_id);
+            out += "OK "s;
+            out += GetStatusName(status);
+            for (std::string_view word : words) {
+                out += ' ';
+                out += word;
+            }
+            out += '\n';
+        }
+        else {
+            AppendError("unknown command"s, out);
+        }
+    }
+    catch (const std::exception& e) {
+        AppendError(e.what(), out);
+    }
+}
+
+void RequestHandler::HandleStats(std::string& out) const {
+    const QueryStatisticsSnapshot snapshot = statistics_.GetSnapshot();
+    out += "OK "s;
+    out += std::to_string(snapshot.query_count);
+    out += ' ';
+    out += std::to_string(snapshot.no_result_count);
+    out += ' ';
+    out += std::to_string(snapshot.latency.GetValueAtPercentile(50));
+    out += ' ';
+    out += std::to_string(snapshot.latency.GetValueAtPercentile(99));
+    for (const auto& [term, count] : snapshot.top_terms) {
+        out += ' ';
+        out += term;
+        out += ':';
+        out += std::to_string(count);
+    }
+    out += '\n';
+}
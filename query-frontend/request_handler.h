@@ -0,0 +1,32 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../search-server/search_server.h"
+#include "../search-server/query_statistics.h"
+
+// Line protocol, one request per line, one response line per request:
+//     ADD <id> <status> <rating,rating,...|-> <text>   -> OK
+//     REMOVE <id>                                      -> OK
+//     SEARCH <query>                                   -> OK <count> (<id> <relevance> <rating>)*
+//     MATCH <id> <query>                               -> OK <status> <word>*
+//     STATS                                            -> OK <queries> <no-result> <p50 ns> <p99 ns> (<term>:<count>)*
+// STATS covers the searches of the last minute.
+// A malformed or failed request is answered with ERR <message>.
+// Consecutive SEARCH lines of one read are answered through the parallel ProcessQueries.
+class RequestHandler {
+public:
+    explicit RequestHandler(SearchServer& search_server, size_t max_batch_size = 256);
+
+    // Appends the responses to out in request order
+    void HandleRequests(const std::vector<std::string_view>& lines, std::string& out);
+
+private:
+    void HandleSearchBatch(const std::vector<std::string_view>& queries, std::string& out);
+    void HandleRequest(std::string_view line, std::string& out);
+    void HandleStats(std::string& out) const;
+
+    SearchServer& search_server_;
+    const size_t max_batch_size_;
+    QueryStatistics statistics_;
+};
@@ -0,0 +1,102 @@
+#include "async_search.h"
+
+namespace {
+
+    QueryContext::Clock::time_point GetDeadline(QueryContext::Clock::duration timeout) {
+        const auto now = QueryContext::Clock::now();
+        if (timeout >= QueryContext::Clock::time_point::max() - now) {
+            return QueryContext::Clock::time_point::max();
+        }
+        return now + timeout;
+    }
+}
+
+AsyncSearchExecutor::AsyncSearchExecutor(const SearchServer& search_server, size_t thread_count)
+    : search_server_(search_server)
+{
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < std::max<size_t>(thread_count, 1); ++i) {
+        workers_.emplace_back([this] { RunWorker(); });
+    }
+}
+
+AsyncSearchExecutor::~AsyncSearchExecutor() {
+    {
+        std::lock_guard guard(queue_mutex_);
+        stopping_ = true;
+    }
+    queue_wakeup_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+QueryHandle AsyncSearchExecutor::Submit(std::string raw_query, Clock::duration timeout) {
+    return Submit(std::move(raw_query), [](int document_id, DocumentStatus status, int rating) {
+        return status == DocumentStatus::ACTUAL;
+        }, timeout);
+}
+
+QueryHandle AsyncSearchExecutor::Submit(std::string raw_query, Predicate predicate, Clock::duration timeout) {
+    auto context = std::make_shared<QueryContext>(GetDeadline(timeout));
+    std::promise<AsyncQueryResult> result;
+    QueryHandle handle(context, result.get_future());
+    {
+        std::lock_guard guard(queue_mutex_);
+        queue_.push_back({ std::move(raw_query), std::move(predicate), std::move(context), std::move(result) });
+    }
+    queue_wakeup_.notify_one();
+    return handle;
+}
+
+std::vector<QueryHandle> AsyncSearchExecutor::SubmitBatch(const std::vector<std::string>& queries, Clock::duration timeout) {
+    std::vector<QueryHandle> handles;
+    handles.reserve(queries.size());
+    for (const std::string& query : queries) {
+        handles.push_back(Submit(query, timeout));
+    }
+    return handles;
+}
+
+void AsyncSearchExecutor::RunWorker() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock lock(queue_mutex_);
+            queue_wakeup_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            task = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        Execute(task);
+    }
+}
+
+void AsyncSearchExecutor::Execute(Task& task) const {
+    const QueryContext& context = *task.context;
+    AsyncQueryResult result;
+    // Expired or cancelled while queued, do not spend a core on it
+    if (context.IsCancelled()) {
+        result.completion = QueryCompletion::CANCELLED;
+        task.result.set_value(std::move(result));
+        return;
+    }
+    if (context.IsDeadlineExceeded()) {
+        result.completion = QueryCompletion::DEADLINE_EXCEEDED;
+        task.result.set_value(std::move(result));
+        return;
+    }
+
+    try {
+        result.documents = search_server_.FindTopDocuments(task.raw_query, task.predicate, context);
+        if (context.WasInterrupted()) {
+            result.completion = context.IsCancelled() ? QueryCompletion::CANCELLED : QueryCompletion::DEADLINE_EXCEEDED;
+        }
+        task.result.set_value(std::move(result));
+    }
+    catch (...) {
+        task.result.set_exception(std::current_exception());
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "search_server.h"
+
+enum class QueryCompletion {
+    COMPLETE,
+    DEADLINE_EXCEEDED,  // documents scored before the deadline are ranked and returned
+    CANCELLED,
+};
+
+struct AsyncQueryResult {
+    std::vector<Document> documents;
+    QueryCompletion completion = QueryCompletion::COMPLETE;
+};
+
+// A submitted query, lets the caller wait for the result or cancel it
+class QueryHandle {
+public:
+    QueryHandle(std::shared_ptr<QueryContext> context, std::future<AsyncQueryResult> result)
+        : context_(std::move(context)), result_(std::move(result))
+    {
+    }
+
+    void Cancel() {
+        context_->Cancel();
+    }
+
+    bool IsReady() const {
+        return result_.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    AsyncQueryResult Get() {
+        return result_.get();
+    }
+
+private:
+    std::shared_ptr<QueryContext> context_;
+    std::future<AsyncQueryResult> result_;
+};
+
+// Runs FindTopDocuments on a fixed pool of worker threads. Queries carry a deadline: a query
+// that waited in the queue past it completes at once without touching the index, a running
+// one stops scanning postings and returns the partial top documents.
+class AsyncSearchExecutor {
+public:
+    using Clock = QueryContext::Clock;
+    using Predicate = std::function<bool(int, DocumentStatus, int)>;
+
+    explicit AsyncSearchExecutor(const SearchServer& search_server,
+        size_t thread_count = std::max(1u, std::thread::hardware_concurrency()));
+
+    AsyncSearchExecutor(const AsyncSearchExecutor&) = delete;
+    AsyncSearchExecutor& operator=(const AsyncSearchExecutor&) = delete;
+
+    // Waits for the queued queries to finish
+    ~AsyncSearchExecutor();
+
+    QueryHandle Submit(std::string raw_query, Clock::duration timeout = Clock::duration::max());
+
+    QueryHandle Submit(std::string raw_query, Predicate predicate, Clock::duration timeout = Clock::duration::max());
+
+    // Asynchronous counterpart of ProcessQueries, every query gets the same timeout
+    std::vector<QueryHandle> SubmitBatch(const std::vector<std::string>& queries,
+        Clock::duration timeout = Clock::duration::max());
+
+private:
+    struct Task {
+        std::string raw_query;
+        Predicate predicate;
+        std::shared_ptr<QueryContext> context;
+        std::promise<AsyncQueryResult> result;
+    };
+
+    void RunWorker();
+
+    void Execute(Task& task) const;
+
+    const SearchServer& search_server_;
+
+    std::mutex queue_mutex_;
+    std::condition_variable queue_wakeup_;
+    std::deque<Task> queue_;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+};
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <cstddef>
+#include <deque>
 #include <map>
 #include <vector>
 #include <mutex>
 #include <string>
+#include <memory_resource>
 
 using namespace std::string_literals;
 
@@ -21,7 +24,30 @@ public:
 
     };
 
-    explicit ConcurrentMap(size_t bucket_count) : all_maps_(bucket_count) {}
+    explicit ConcurrentMap(size_t bucket_count) {
+        for (size_t i = 0; i < bucket_count; ++i) {
+            all_maps_.emplace_back();
+        }
+    }
+
+    // Every bucket starts with room for about expected_size / bucket_count entries carved out of
+    // resource, which is only used by the constructor and the destructor. A bucket that outgrows
+    // its room takes more from overflow_resource, which must be thread-safe.
+    ConcurrentMap(size_t bucket_count, size_t expected_size, std::pmr::memory_resource* resource,
+        std::pmr::memory_resource* overflow_resource)
+        : buffers_{ resource }, all_maps_(resource)
+    {
+        // A tree node is the entry plus three links and the color
+        const size_t node_bytes = sizeof(std::pair<const Key, Value>) + 4 * sizeof(void*);
+        // With a hundred buckets some are always well above the mean, small buckets vary the most
+        const size_t alignment = alignof(std::max_align_t);
+        const size_t bucket_bytes = ((expected_size / bucket_count * 2 + 16) * node_bytes + alignment - 1) / alignment * alignment;
+        buffers_.size = bucket_bytes * bucket_count;
+        buffers_.data = static_cast<std::byte*>(resource->allocate(buffers_.size, alignment));
+        for (size_t i = 0; i < bucket_count; ++i) {
+            all_maps_.emplace_back(buffers_.data + i * bucket_bytes, bucket_bytes, overflow_resource);
+        }
+    }
 
     Access operator[](const Key& key) {
         int index = static_cast<uint64_t>(key) % all_maps_.size();
@@ -34,12 +60,32 @@ public:
 
         for (ConcurrentMap::LittleMap& _map : all_maps_) {
             std::lock_guard g(_map.little_map_mutex);
-            result.merge(_map.little_map);
+            result.insert(_map.little_map.begin(), _map.little_map.end());
         }
 
         return result;
     }
 
+    size_t GetSize() {
+        size_t size = 0;
+        for (ConcurrentMap::LittleMap& _map : all_maps_) {
+            std::lock_guard g(_map.little_map_mutex);
+            size += _map.little_map.size();
+        }
+        return size;
+    }
+
+    // Calls callback(key, value) for every entry without copying the map, ordered by key only within a bucket
+    template <typename Callback>
+    void ForEach(Callback callback) {
+        for (ConcurrentMap::LittleMap& _map : all_maps_) {
+            std::lock_guard g(_map.little_map_mutex);
+            for (const auto& [key, value] : _map.little_map) {
+                callback(key, value);
+            }
+        }
+    }
+
     auto Erase(const Key& key) {
         int index = static_cast<uint64_t>(key) % all_maps_.size();
         std::lock_guard g(all_maps_[index].little_map_mutex);
@@ -48,11 +94,33 @@ public:
 
 private:
 
+    // Nodes come from a bump allocator owned by the bucket, its mutex already serializes allocations
     struct LittleMap {
+        LittleMap() = default;
+
+        LittleMap(void* buffer, size_t buffer_size, std::pmr::memory_resource* upstream)
+            : little_map_resource(buffer, buffer_size, upstream) {}
+
         std::mutex little_map_mutex;
-        std::map<Key, Value> little_map;
+        std::pmr::monotonic_buffer_resource little_map_resource;
+        std::pmr::map<Key, Value> little_map{ &little_map_resource };
+    };
+
+    // Initial room of the buckets, declared first so that it is released after them
+    struct BucketBuffers {
+        std::pmr::memory_resource* resource = nullptr;
+        std::byte* data = nullptr;
+        size_t size = 0;
+
+        ~BucketBuffers() {
+            if (data) {
+                resource->deallocate(data, size, alignof(std::max_align_t));
+            }
+        }
     };
 
-    std::vector<LittleMap> all_maps_;
+    BucketBuffers buffers_;
+    // A deque, the buckets hold mutexes and cannot be moved
+    std::pmr::deque<LittleMap> all_maps_;
 
 };
@@ -0,0 +1,195 @@
+#include "corpus_loader.h"
+
+#include <charconv>
+#include <exception>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string& path) {
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error("Failed to open the corpus "s + path);
+            }
+            struct stat file_stat;
+            if (::fstat(fd, &file_stat) != 0) {
+                ::close(fd);
+                throw std::runtime_error("Failed to stat the corpus "s + path);
+            }
+            size_ = static_cast<size_t>(file_stat.st_size);
+            if (size_ > 0) {
+                data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            }
+            ::close(fd);
+            if (data_ == MAP_FAILED) {
+                throw std::runtime_error("Failed to map the corpus "s + path);
+            }
+            if (size_ > 0) {
+                ::madvise(data_, size_, MADV_SEQUENTIAL);
+            }
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile() {
+            if (size_ > 0) {
+                ::munmap(data_, size_);
+            }
+        }
+
+        std::string_view GetData() const {
+            return { static_cast<const char*>(data_), size_ };
+        }
+
+    private:
+        void* data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    struct CorpusDocument {
+        int id;
+        DocumentStatus status;
+        std::vector<int> ratings;
+        std::string_view text;
+    };
+
+    struct ParsedChunk {
+        std::vector<CorpusDocument> documents;
+        std::exception_ptr error;
+    };
+
+    std::string_view NextField(std::string_view& line) {
+        const size_t tab = line.find('\t');
+        if (tab == line.npos) {
+            throw std::invalid_argument("The corpus line has too few fields"s);
+        }
+        std::string_view field = line.substr(0, tab);
+        line.remove_prefix(tab + 1);
+        return field;
+    }
+
+    int ParseInt(std::string_view text) {
+        int value = 0;
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (error != std::errc{} || end != text.data() + text.size()) {
+            throw std::invalid_argument("The corpus contains an invalid number"s);
+        }
+        return value;
+    }
+
+    DocumentStatus ParseStatus(std::string_view text) {
+        if (text == "ACTUAL") {
+            return DocumentStatus::ACTUAL;
+        }
+        if (text == "IRRELEVANT") {
+            return DocumentStatus::IRRELEVANT;
+        }
+        if (text == "BANNED") {
+            return DocumentStatus::BANNED;
+        }
+        if (text == "REMOVED") {
+            return DocumentStatus::REMOVED;
+        }
+        const int status = ParseInt(text);
+        if (status < static_cast<int>(DocumentStatus::ACTUAL) || status > static_cast<int>(DocumentStatus::REMOVED)) {
+            throw std::invalid_argument("The corpus contains an invalid document status"s);
+        }
+        return static_cast<DocumentStatus>(status);
+    }
+
+    CorpusDocument ParseLine(std::string_view line) {
+        CorpusDocument document;
+        document.id = ParseInt(NextField(line));
+        document.status = ParseStatus(NextField(line));
+        for (std::string_view rating : SplitIntoWords(NextField(line))) {
+            document.ratings.push_back(ParseInt(rating));
+        }
+        document.text = line;
+        return document;
+    }
+
+    std::vector<CorpusDocument> ParseChunk(std::string_view chunk, size_t chunk_offset, std::string_view data) {
+        std::vector<CorpusDocument> documents;
+        while (!chunk.empty()) {
+            const size_t line_end = std::min(chunk.find('\n'), chunk.size());
+            std::string_view line = chunk.substr(0, line_end);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (!line.empty()) {
+                try {
+                    documents.push_back(ParseLine(line));
+                }
+                catch (const std::invalid_argument& e) {
+                    const size_t line_number = std::count(data.begin(), data.begin() + chunk_offset, '\n') + 1;
+                    throw std::invalid_argument(std::string(e.what()) + " at line "s + std::to_string(line_number));
+                }
+            }
+            const size_t consumed = std::min(line_end + 1, chunk.size());
+            chunk.remove_prefix(consumed);
+            chunk_offset += consumed;
+        }
+        return documents;
+    }
+
+    // Splits data into about chunk_count pieces, each ending right after a line break
+    std::vector<std::pair<size_t, size_t>> SplitIntoChunks(std::string_view data, size_t chunk_count) {
+        std::vector<std::pair<size_t, size_t>> chunks;
+        const size_t chunk_size = std::max(MIN_CHUNK_SIZE, data.size() / chunk_count + 1);
+        size_t begin = 0;
+        while (begin < data.size()) {
+            size_t end = std::min(begin + chunk_size, data.size());
+            if (end < data.size()) {
+                const size_t line_break = data.find('\n', end - 1);
+                end = line_break == data.npos ? data.size() : line_break + 1;
+            }
+            chunks.push_back({ begin, end });
+            begin = end;
+        }
+        return chunks;
+    }
+}
+
+size_t LoadCorpus(const std::string& path, SearchServer& search_server) {
+    const MappedFile file(path);
+    const std::string_view data = file.GetData();
+
+    const auto chunks = SplitIntoChunks(data, std::max(1u, std::thread::hardware_concurrency()) * 4);
+    std::vector<ParsedChunk> parsed_chunks(chunks.size());
+    // An exception escaping a parallel algorithm terminates the program, so errors are carried out
+    std::transform(std::execution::par, chunks.begin(), chunks.end(), parsed_chunks.begin(),
+        [data](const std::pair<size_t, size_t>& chunk) {
+            ParsedChunk parsed;
+            try {
+                parsed.documents = ParseChunk(data.substr(chunk.first, chunk.second - chunk.first), chunk.first, data);
+            }
+            catch (...) {
+                parsed.error = std::current_exception();
+            }
+            return parsed;
+        });
+
+    // The index is not thread-safe, documents are added in file order
+    size_t document_count = 0;
+    for (const ParsedChunk& parsed : parsed_chunks) {
+        if (parsed.error) {
+            std::rethrow_exception(parsed.error);
+        }
+    }
+    for (const ParsedChunk& parsed : parsed_chunks) {
+        for (const CorpusDocument& document : parsed.documents) {
+            search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+            ++document_count;
+        }
+    }
+    return document_count;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+#include "search_server.h"
+
+// Loads a TSV corpus into the server, one document per line:
+//     id <TAB> status <TAB> ratings separated by spaces <TAB> text
+// status is ACTUAL, IRRELEVANT, BANNED, REMOVED or its number.
+// The file is memory-mapped and split at line boundaries into chunks that are parsed in parallel,
+// document text is passed to AddDocument straight from the mapping.
+// Returns the number of added documents.
+size_t LoadCorpus(const std::string& path, SearchServer& search_server);
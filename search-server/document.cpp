@@ -1,8 +1,27 @@
 #include "document.h"
 
+#include <cmath>
+#include <numeric>
+
+int ComputeAverageRating(const std::vector<int>& ratings) {
+    if (ratings.empty()) {
+        return 0;
+    }
+    int rating_sum = std::accumulate(ratings.begin(), ratings.end(), 0);
+    return rating_sum / static_cast<int>(ratings.size());
+}
+
 std::ostream& operator<<(std::ostream& output, const Document& document) {
 
     output << "{ document_id = "s << document.id << ", relevance = "s << document.relevance << ", rating = "s << document.rating << " }"s;
 
     return output;
 }
+
+bool IsRankedBefore(const Document& lhs, const Document& rhs) {
+    const double epsilon = 1e-6;
+    if (std::abs(lhs.relevance - rhs.relevance) < epsilon) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
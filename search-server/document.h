@@ -1,5 +1,6 @@
 #pragma once
 #include <iostream>
+#include <vector>
 
 using namespace std::string_literals;
 
@@ -24,3 +25,9 @@ enum class DocumentStatus {
 };
 
 std::ostream& operator<<(std::ostream& output, const Document& document);
+
+// Integer mean of the ratings, 0 without ratings
+int ComputeAverageRating(const std::vector<int>& ratings);
+
+// The order of search results: higher relevance first, equal relevance (within 1e-6) by higher rating
+bool IsRankedBefore(const Document& lhs, const Document& rhs);
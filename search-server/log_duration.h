@@ -2,6 +2,7 @@
 
 #include <chrono>
 #include <iostream>
+#include <string>
 
 #define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
 #define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
@@ -22,7 +23,8 @@ public:
 
         const auto end_time = Clock::now();
         const auto dur = end_time - start_time_;
-        out_ << "Operation time: "s << duration_cast<milliseconds>(dur).count() << " ms"s << std::endl;
+        out_ << (id_.empty() ? "Operation time"s : id_) << ": "s
+            << duration_cast<duration<double, std::milli>>(dur).count() << " ms"s << std::endl;
     }
 
 private:
@@ -1,17 +1,49 @@
 #include "process_queries.h"
 #include "search_server.h"
+#include <atomic>
+#include <cstdlib>
 #include <execution>
 #include <iostream>
+#include <new>
 #include <string>
 #include <vector>
 
 using namespace std;
+
+// Every heap allocation of the program, pmr upstreams included, goes through here
+static atomic<size_t> heap_allocations = 0;
+
+void* operator new(size_t size) {
+    heap_allocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
 void PrintDocument(const Document& document) {
     cout << "{ "s
         << "document_id = "s << document.id << ", "s
         << "relevance = "s << document.relevance << ", "s
         << "rating = "s << document.rating << " }"s << endl;
 }
+
+// The first queries size the scratch block and start the workers, later ones allocate only their result
+template <typename ExecutionPolicy>
+void PrintQueryAllocations(const ExecutionPolicy& policy, const SearchServer& search_server, const string& raw_query) {
+    search_server.FindTopDocuments(policy, raw_query);
+    const size_t before = heap_allocations.load(memory_order_relaxed);
+    search_server.FindTopDocuments(policy, raw_query);
+    cout << heap_allocations.load(memory_order_relaxed) - before << " heap allocations"s << endl;
+}
 int main() {
     SearchServer search_server("and with"s);
     int id = 0;
@@ -40,5 +72,10 @@ int main() {
     for (const Document& document : search_server.FindTopDocuments(execution::par, "curly nasty cat"s, [](int document_id, DocumentStatus status, int rating) { return document_id % 2 == 0; })) {
         PrintDocument(document);
     }
+    cout << "Sequential query: "s;
+    PrintQueryAllocations(execution::seq, search_server, "curly nasty cat"s);
+    cout << "Parallel query: "s;
+    PrintQueryAllocations(execution::par, search_server, "curly nasty cat"s);
+    cout << "Query scratch: "s << QueryScratch::GetStats() << endl;
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "memory_resources.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace {
+
+    CountingMemoryResource& GetScratchUpstream() {
+        static CountingMemoryResource upstream(std::pmr::new_delete_resource());
+        return upstream;
+    }
+
+    struct ScratchBlock {
+        std::byte* data = nullptr;
+        size_t size = 0;
+        size_t wanted_size = 0; // what the largest query so far needed
+        bool in_use = false;
+
+        ~ScratchBlock() {
+            if (data) {
+                GetScratchUpstream().deallocate(data, size, alignof(std::max_align_t));
+            }
+        }
+    };
+
+    ScratchBlock& GetScratchBlock() {
+        // The upstream must outlive the block of the main thread
+        GetScratchUpstream();
+        thread_local ScratchBlock block;
+        return block;
+    }
+}
+
+std::ostream& operator<<(std::ostream& output, const AllocationStats& stats) {
+    output << "{ allocations = "s << stats.allocations
+        << ", deallocations = "s << stats.deallocations
+        << ", bytes allocated = "s << stats.bytes_allocated
+        << ", bytes in use = "s << stats.bytes_in_use << " }"s;
+    return output;
+}
+
+CountingMemoryResource::CountingMemoryResource(std::pmr::memory_resource* upstream)
+    : upstream_(upstream)
+{
+}
+
+AllocationStats CountingMemoryResource::GetStats() const {
+    AllocationStats stats;
+    stats.allocations = allocations_.load(std::memory_order_relaxed);
+    stats.deallocations = deallocations_.load(std::memory_order_relaxed);
+    stats.bytes_allocated = bytes_allocated_.load(std::memory_order_relaxed);
+    stats.bytes_in_use = bytes_in_use_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void* CountingMemoryResource::do_allocate(size_t bytes, size_t alignment) {
+    void* p = upstream_->allocate(bytes, alignment);
+    allocations_.fetch_add(1, std::memory_order_relaxed);
+    bytes_allocated_.fetch_add(bytes, std::memory_order_relaxed);
+    bytes_in_use_.fetch_add(bytes, std::memory_order_relaxed);
+    return p;
+}
+
+void CountingMemoryResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    upstream_->deallocate(p, bytes, alignment);
+    deallocations_.fetch_add(1, std::memory_order_relaxed);
+    bytes_in_use_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+bool CountingMemoryResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+QueryScratch::QueryScratch(size_t expected_bytes)
+    : overflow_(&GetScratchUpstream())
+{
+    ScratchBlock& block = GetScratchBlock();
+    CountingMemoryResource& upstream = GetScratchUpstream();
+    if (block.in_use) {
+        // Nested query on the same thread, the block is taken
+        resource_.emplace(expected_bytes, &overflow_);
+        return;
+    }
+    const size_t required = std::max(expected_bytes, block.wanted_size);
+    if (block.size < required) {
+        if (block.data) {
+            upstream.deallocate(block.data, block.size, alignof(std::max_align_t));
+            block.data = nullptr;
+        }
+        const size_t size = std::max(required, block.size * 2);
+        block.data = static_cast<std::byte*>(upstream.allocate(size, alignof(std::max_align_t)));
+        block.size = size;
+    }
+    block.in_use = true;
+    owns_block_ = true;
+    resource_.emplace(block.data, block.size, &overflow_);
+}
+
+QueryScratch::~QueryScratch() {
+    resource_.reset();
+    if (owns_block_) {
+        ScratchBlock& block = GetScratchBlock();
+        block.in_use = false;
+        const size_t overflow_bytes = overflow_.GetStats().bytes_allocated;
+        if (overflow_bytes > 0) {
+            block.wanted_size = std::max(block.wanted_size, block.size + overflow_bytes);
+        }
+    }
+}
+
+std::pmr::memory_resource* QueryScratch::GetResource() {
+    return &*resource_;
+}
+
+std::pmr::memory_resource* QueryScratch::GetSynchronizedResource() {
+    // Not the overflow: a larger block would not give the parallel parts more room
+    return &GetScratchUpstream();
+}
+
+AllocationStats QueryScratch::GetStats() {
+    return GetScratchUpstream().GetStats();
+}
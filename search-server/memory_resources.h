@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <iostream>
+#include <memory_resource>
+#include <optional>
+
+using namespace std::string_literals;
+
+struct AllocationStats {
+    size_t allocations = 0;
+    size_t deallocations = 0;
+    size_t bytes_allocated = 0;
+    size_t bytes_in_use = 0;
+};
+
+std::ostream& operator<<(std::ostream& output, const AllocationStats& stats);
+
+// Forwards to the upstream resource and counts what goes through it
+class CountingMemoryResource : public std::pmr::memory_resource {
+public:
+    explicit CountingMemoryResource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+    AllocationStats GetStats() const;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    std::pmr::memory_resource* const upstream_;
+    std::atomic<size_t> allocations_ = 0;
+    std::atomic<size_t> deallocations_ = 0;
+    std::atomic<size_t> bytes_allocated_ = 0;
+    std::atomic<size_t> bytes_in_use_ = 0;
+};
+
+// Monotonic memory for the temporaries of one query. It is carved out of a per-thread block
+// that survives between queries. Whatever a query needs beyond the block comes from the heap
+// and the block grows by that much for the next query on the same thread, so in the steady
+// state the temporaries do not touch the heap.
+class QueryScratch {
+public:
+    explicit QueryScratch(size_t expected_bytes);
+
+    QueryScratch(const QueryScratch&) = delete;
+    QueryScratch& operator=(const QueryScratch&) = delete;
+
+    ~QueryScratch();
+
+    // Only for the thread that created the scratch
+    std::pmr::memory_resource* GetResource();
+
+    // Thread-safe heap memory for parallel parts of the query, counted in GetStats()
+    std::pmr::memory_resource* GetSynchronizedResource();
+
+    // Heap traffic of scratch memory in the whole process: the per-thread blocks and the overflow
+    // of queries that did not fit. Memory a query allocates elsewhere, such as its result, is not seen here
+    static AllocationStats GetStats();
+
+private:
+    bool owns_block_ = false;
+    CountingMemoryResource overflow_; // what the query needed beyond the block
+    std::optional<std::pmr::monotonic_buffer_resource> resource_;
+};
@@ -0,0 +1,227 @@
+#include "metrics.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+namespace {
+
+    const size_t METRIC_COUNT = static_cast<size_t>(Metric::COUNT);
+
+    // Written only by the owning thread, so plain load + store is enough
+    struct ThreadMetrics {
+        std::array<std::atomic<uint64_t>, METRIC_COUNT> counts = {};
+        std::array<std::atomic<uint64_t>, METRIC_COUNT> total_ns = {};
+        std::array<std::atomic<uint64_t>, METRIC_COUNT> max_ns = {};
+        std::array<std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKET_COUNT>, METRIC_COUNT> buckets = {};
+    };
+
+    void Increase(std::atomic<uint64_t>& counter, uint64_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    void AddToSnapshot(const ThreadMetrics& metrics, MetricsSnapshot& snapshot) {
+        for (size_t metric = 0; metric < METRIC_COUNT; ++metric) {
+            MetricSnapshot& target = snapshot[metric];
+            target.count += metrics.counts[metric].load(std::memory_order_relaxed);
+            target.total_ns += metrics.total_ns[metric].load(std::memory_order_relaxed);
+            target.max_ns = std::max(target.max_ns, metrics.max_ns[metric].load(std::memory_order_relaxed));
+            for (size_t bucket = 0; bucket < LatencyHistogram::BUCKET_COUNT; ++bucket) {
+                const uint64_t count = metrics.buckets[metric][bucket].load(std::memory_order_relaxed);
+                if (count != 0) {
+                    target.histogram.Add(bucket, count);
+                }
+            }
+        }
+    }
+
+    struct Registry {
+        std::mutex mutex;
+        std::vector<const ThreadMetrics*> live;
+        MetricsSnapshot retired;
+    };
+
+    Registry& GetRegistry() {
+        static Registry registry;
+        return registry;
+    }
+
+    // Registers the thread's counters on first use and folds them into the totals on thread exit
+    class ThreadMetricsHolder {
+    public:
+        ThreadMetricsHolder()
+            : registry_(GetRegistry()), metrics_(std::make_unique<ThreadMetrics>())
+        {
+            std::lock_guard guard(registry_.mutex);
+            registry_.live.push_back(metrics_.get());
+        }
+
+        ~ThreadMetricsHolder() {
+            std::lock_guard guard(registry_.mutex);
+            registry_.live.erase(std::find(registry_.live.begin(), registry_.live.end(), metrics_.get()));
+            AddToSnapshot(*metrics_, registry_.retired);
+        }
+
+        ThreadMetrics& Get() {
+            return *metrics_;
+        }
+
+    private:
+        Registry& registry_;
+        std::unique_ptr<ThreadMetrics> metrics_;
+    };
+
+    std::atomic<bool> metrics_enabled = true;
+
+    // Bucket bounds may overshoot the largest recorded value
+    uint64_t GetPercentile(const MetricSnapshot& data, double percentile) {
+        return std::min(data.histogram.GetValueAtPercentile(percentile), data.max_ns);
+    }
+}
+
+
+std::string_view GetMetricName(Metric metric) {
+    switch (metric) {
+    case Metric::ADD_DOCUMENT:
+        return "AddDocument";
+    case Metric::PARSE_QUERY:
+        return "ParseQuery";
+    case Metric::FIND_ALL_DOCUMENTS:
+        return "FindAllDocuments";
+    case Metric::SORT_DOCUMENTS:
+        return "SortDocuments";
+    case Metric::MATCH_DOCUMENT:
+        return "MatchDocument";
+    case Metric::REMOVE_DOCUMENT:
+        return "RemoveDocument";
+    case Metric::PROCESS_QUERIES:
+        return "ProcessQueries";
+    default:
+        return "Unknown";
+    }
+}
+
+size_t LatencyHistogram::GetBucketIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    const int exponent = 63 - __builtin_clzll(value);
+    const uint64_t mantissa = (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+    return static_cast<size_t>(exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + mantissa;
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const int exponent = static_cast<int>(index / SUB_BUCKET_COUNT) + SUB_BUCKET_BITS - 1;
+    const uint64_t mantissa = index % SUB_BUCKET_COUNT;
+    const int shift = exponent - SUB_BUCKET_BITS;
+    return ((SUB_BUCKET_COUNT + mantissa) << shift) + ((uint64_t{ 1 } << shift) - 1);
+}
+
+void LatencyHistogram::Add(size_t index, uint64_t count) {
+    buckets_[index] += count;
+    count_ += count;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+    for (size_t index = 0; index < BUCKET_COUNT; ++index) {
+        buckets_[index] += other.buckets_[index];
+    }
+    count_ += other.count_;
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+    return count_;
+}
+
+uint64_t LatencyHistogram::GetValueAtPercentile(double percentile) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(percentile / 100.0 * count_ + 0.5));
+    uint64_t seen = 0;
+    for (size_t index = 0; index < BUCKET_COUNT; ++index) {
+        seen += buckets_[index];
+        if (seen >= rank) {
+            return GetBucketUpperBound(index);
+        }
+    }
+    return GetBucketUpperBound(BUCKET_COUNT - 1);
+}
+
+void SetMetricsEnabled(bool enabled) {
+    metrics_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool IsMetricsEnabled() {
+#ifdef SEARCH_SERVER_DISABLE_METRICS
+    return false;
+#else
+    return metrics_enabled.load(std::memory_order_relaxed);
+#endif
+}
+
+void RecordLatency(Metric metric, uint64_t nanoseconds) {
+    thread_local ThreadMetricsHolder holder;
+    ThreadMetrics& metrics = holder.Get();
+    const size_t index = static_cast<size_t>(metric);
+
+    Increase(metrics.counts[index], 1);
+    Increase(metrics.total_ns[index], nanoseconds);
+    if (nanoseconds > metrics.max_ns[index].load(std::memory_order_relaxed)) {
+        metrics.max_ns[index].store(nanoseconds, std::memory_order_relaxed);
+    }
+    Increase(metrics.buckets[index][LatencyHistogram::GetBucketIndex(nanoseconds)], 1);
+}
+
+MetricsSnapshot TakeMetricsSnapshot() {
+    Registry& registry = GetRegistry();
+    std::lock_guard guard(registry.mutex);
+    MetricsSnapshot snapshot = registry.retired;
+    for (const ThreadMetrics* metrics : registry.live) {
+        AddToSnapshot(*metrics, snapshot);
+    }
+    return snapshot;
+}
+
+void PrintMetricsText(std::ostream& out, const MetricsSnapshot& snapshot) {
+    for (size_t metric = 0; metric < METRIC_COUNT; ++metric) {
+        const MetricSnapshot& data = snapshot[metric];
+        if (data.count == 0) {
+            continue;
+        }
+        out << GetMetricName(static_cast<Metric>(metric))
+            << " count="s << data.count
+            << " mean_ns="s << data.total_ns / data.count
+            << " p50_ns="s << GetPercentile(data, 50)
+            << " p99_ns="s << GetPercentile(data, 99)
+            << " p999_ns="s << GetPercentile(data, 99.9)
+            << " max_ns="s << data.max_ns << '\n';
+    }
+}
+
+void PrintMetricsJson(std::ostream& out, const MetricsSnapshot& snapshot) {
+    out << '{';
+    bool first = true;
+    for (size_t metric = 0; metric < METRIC_COUNT; ++metric) {
+        const MetricSnapshot& data = snapshot[metric];
+        if (!first) {
+            out << ',';
+        }
+        first = false;
+        out << '"' << GetMetricName(static_cast<Metric>(metric)) << "\":{"s
+            << "\"count\":"s << data.count
+            << ",\"total_ns\":"s << data.total_ns
+            << ",\"max_ns\":"s << data.max_ns
+            << ",\"p50_ns\":"s << GetPercentile(data, 50)
+            << ",\"p90_ns\":"s << GetPercentile(data, 90)
+            << ",\"p99_ns\":"s << GetPercentile(data, 99)
+            << ",\"p999_ns\":"s << GetPercentile(data, 99.9)
+            << '}';
+    }
+    out << '}';
+}
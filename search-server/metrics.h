@@ -0,0 +1,98 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+#include "log_duration.h"
+
+using namespace std::string_literals;
+
+// Operations measured by the metrics subsystem
+enum class Metric {
+    ADD_DOCUMENT,
+    PARSE_QUERY,
+    FIND_ALL_DOCUMENTS,
+    SORT_DOCUMENTS,
+    MATCH_DOCUMENT,
+    REMOVE_DOCUMENT,
+    PROCESS_QUERIES,
+    COUNT,
+};
+
+std::string_view GetMetricName(Metric metric);
+
+// Log-linear latency histogram in nanoseconds: values below 32 are exact, larger values
+// fall into 32 sub-buckets per power of two, which keeps the relative error under ~3%
+class LatencyHistogram {
+public:
+    static const int SUB_BUCKET_BITS = 5;
+    static const size_t SUB_BUCKET_COUNT = size_t{ 1 } << SUB_BUCKET_BITS;
+    static const size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    static size_t GetBucketIndex(uint64_t value);
+    static uint64_t GetBucketUpperBound(size_t index);
+
+    void Add(size_t index, uint64_t count);
+
+    void Merge(const LatencyHistogram& other);
+
+    uint64_t GetCount() const;
+    uint64_t GetValueAtPercentile(double percentile) const;
+
+private:
+    std::array<uint64_t, BUCKET_COUNT> buckets_ = {};
+    uint64_t count_ = 0;
+};
+
+struct MetricSnapshot {
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    LatencyHistogram histogram;
+};
+
+using MetricsSnapshot = std::array<MetricSnapshot, static_cast<size_t>(Metric::COUNT)>;
+
+// Recording is enabled by default, defining SEARCH_SERVER_DISABLE_METRICS compiles it out
+void SetMetricsEnabled(bool enabled);
+bool IsMetricsEnabled();
+
+// Adds one sample to the calling thread's counters, never takes a lock
+void RecordLatency(Metric metric, uint64_t nanoseconds);
+
+// Sums the counters of all threads, including threads that have already finished
+MetricsSnapshot TakeMetricsSnapshot();
+
+void PrintMetricsText(std::ostream& out, const MetricsSnapshot& snapshot);
+void PrintMetricsJson(std::ostream& out, const MetricsSnapshot& snapshot);
+
+class ScopedMetric {
+public:
+    using Clock = LogDuration::Clock;
+
+    explicit ScopedMetric(Metric metric)
+        : metric_(metric), start_time_(IsMetricsEnabled() ? Clock::now() : Clock::time_point{})
+    {
+    }
+
+    ScopedMetric(const ScopedMetric&) = delete;
+    ScopedMetric& operator=(const ScopedMetric&) = delete;
+
+    ~ScopedMetric() {
+        if (start_time_ != Clock::time_point{}) {
+            const auto dur = Clock::now() - start_time_;
+            RecordLatency(metric_, std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count());
+        }
+    }
+
+private:
+    const Metric metric_;
+    const Clock::time_point start_time_;
+};
+
+#ifdef SEARCH_SERVER_DISABLE_METRICS
+#define SEARCH_METRIC_SCOPE(metric)
+#else
+#define SEARCH_METRIC_SCOPE(metric) ScopedMetric UNIQUE_VAR_NAME_PROFILE(metric)
+#endif
@@ -0,0 +1,289 @@
+#include "mutation_log.h"
+#include "search_server.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+    // record header: payload size, CRC32 of type + payload, type
+    const size_t RECORD_HEADER_SIZE = sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint8_t);
+
+    std::array<uint32_t, 256> MakeCrcTable() {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+            }
+            table[i] = value;
+        }
+        return table;
+    }
+
+    uint32_t ComputeCrc(uint8_t type, std::string_view payload) {
+        static const std::array<uint32_t, 256> table = MakeCrcTable();
+        uint32_t crc = 0xFFFFFFFFu;
+        crc = table[(crc ^ type) & 0xFF] ^ (crc >> 8);
+        for (const char c : payload) {
+            crc = table[(crc ^ static_cast<uint8_t>(c)) & 0xFF] ^ (crc >> 8);
+        }
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    template <typename T>
+    void Put(std::string& out, T value) {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        out.append(bytes, sizeof(T));
+    }
+
+    template <typename T>
+    bool Get(std::string_view& in, T& value) {
+        if (in.size() < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, in.data(), sizeof(T));
+        in.remove_prefix(sizeof(T));
+        return true;
+    }
+
+    // Writes and clears data. On failure only the unwritten tail is left in data, so a retry
+    // continues right after the bytes that already reached the file
+    void WriteAll(int fd, std::string& data) {
+        size_t offset = 0;
+        while (offset < data.size()) {
+            const ssize_t written = ::write(fd, data.data() + offset, data.size() - offset);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                data.erase(0, offset);
+                throw std::runtime_error("Failed to write the mutation log"s);
+            }
+            offset += static_cast<size_t>(written);
+        }
+        data.clear();
+    }
+
+    std::string ReadFile(const std::string& path) {
+        std::ifstream input(path, std::ios::binary);
+        return { std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>() };
+    }
+}
+
+MutationLog::MutationLog(const std::string& path, SyncPolicy sync_policy, size_t group_commit_bytes,
+    std::chrono::milliseconds max_commit_delay)
+    : path_(path), sync_policy_(sync_policy), group_commit_bytes_(group_commit_bytes)
+    , max_commit_delay_(std::max(max_commit_delay, std::chrono::milliseconds(0)))
+{
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to open the mutation log "s + path_);
+    }
+    // Cut off a record torn by a crash so that new records are not appended after garbage
+    const size_t valid_end = FindValidEnd(ReadFile(path_));
+    if (::ftruncate(fd_, static_cast<off_t>(valid_end)) != 0 || ::lseek(fd_, 0, SEEK_END) < 0) {
+        ::close(fd_);
+        throw std::runtime_error("Failed to recover the mutation log "s + path_);
+    }
+    committer_ = std::thread([this] { RunCommitter(); });
+}
+
+MutationLog::~MutationLog() {
+    {
+        std::lock_guard guard(mutex_);
+        stopping_ = true;
+    }
+    committer_wakeup_.notify_one();
+    committer_.join();
+    try {
+        Commit();
+    }
+    catch (...) {
+    }
+    ::close(fd_);
+}
+
+void MutationLog::LogAddDocument(int document_id, std::string_view document, DocumentStatus status,
+    const std::vector<int>& ratings) {
+
+    std::string payload;
+    payload.reserve(sizeof(int32_t) * (3 + ratings.size()) + sizeof(uint8_t) + document.size());
+    Put<int32_t>(payload, document_id);
+    Put<uint8_t>(payload, static_cast<uint8_t>(status));
+    Put<uint32_t>(payload, static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+        Put<int32_t>(payload, rating);
+    }
+    Put<uint32_t>(payload, static_cast<uint32_t>(document.size()));
+    payload.append(document);
+    AppendRecord(RecordType::ADD_DOCUMENT, payload);
+}
+
+void MutationLog::LogRemoveDocument(int document_id) {
+    std::string payload;
+    Put<int32_t>(payload, document_id);
+    AppendRecord(RecordType::REMOVE_DOCUMENT, payload);
+}
+
+void MutationLog::Commit() {
+    std::lock_guard guard(mutex_);
+    RethrowCommitError();
+    CommitLocked();
+}
+
+void MutationLog::Truncate() {
+    std::lock_guard guard(mutex_);
+    buffer_.clear();
+    sync_pending_ = false;
+    if (::ftruncate(fd_, 0) != 0 || ::lseek(fd_, 0, SEEK_SET) < 0) {
+        throw std::runtime_error("Failed to truncate the mutation log"s);
+    }
+    if (sync_policy_ != SyncPolicy::NEVER) {
+        ::fsync(fd_);
+    }
+}
+
+size_t MutationLog::Replay(const std::string& path, SearchServer& search_server) {
+    const std::string data = ReadFile(path);
+    std::string_view records(data.data(), FindValidEnd(data));
+
+    size_t applied = 0;
+    while (!records.empty()) {
+        uint32_t size = 0;
+        uint32_t crc = 0;
+        uint8_t type = 0;
+        Get(records, size);
+        Get(records, crc);
+        Get(records, type);
+        std::string_view payload = records.substr(0, size);
+        records.remove_prefix(size);
+
+        int32_t document_id = 0;
+        Get(payload, document_id);
+        if (type == static_cast<uint8_t>(RecordType::ADD_DOCUMENT)) {
+            uint8_t status = 0;
+            uint32_t rating_count = 0;
+            Get(payload, status);
+            Get(payload, rating_count);
+            std::vector<int> ratings(rating_count);
+            for (int& rating : ratings) {
+                int32_t value = 0;
+                Get(payload, value);
+                rating = value;
+            }
+            uint32_t text_size = 0;
+            Get(payload, text_size);
+            search_server.AddDocument(document_id, payload.substr(0, text_size), static_cast<DocumentStatus>(status), ratings);
+        }
+        else {
+            search_server.RemoveDocument(document_id);
+        }
+        ++applied;
+    }
+    return applied;
+}
+
+void MutationLog::AppendRecord(RecordType type, const std::string& payload) {
+    std::lock_guard guard(mutex_);
+    const bool was_empty = buffer_.empty();
+    Put<uint32_t>(buffer_, static_cast<uint32_t>(payload.size()));
+    Put<uint32_t>(buffer_, ComputeCrc(static_cast<uint8_t>(type), payload));
+    Put<uint8_t>(buffer_, static_cast<uint8_t>(type));
+    buffer_.append(payload);
+    if (was_empty) {
+        first_buffered_time_ = std::chrono::steady_clock::now();
+    }
+
+    // The index already holds the mutation, so a failed commit must not make the caller believe
+    // it was not logged: the record stays buffered and Commit() reports the failure
+    if (commit_error_) {
+        return;
+    }
+    if (sync_policy_ == SyncPolicy::EVERY_RECORD || buffer_.size() >= group_commit_bytes_) {
+        try {
+            CommitLocked();
+        }
+        catch (...) {
+            commit_error_ = std::current_exception();
+        }
+    }
+    else if (was_empty) {
+        committer_wakeup_.notify_one();
+    }
+}
+
+void MutationLog::RunCommitter() {
+    std::unique_lock lock(mutex_);
+    while (!stopping_) {
+        // After a failure the records stay buffered until the error is reported
+        if (buffer_.empty() || commit_error_) {
+            committer_wakeup_.wait(lock, [this] { return stopping_ || (!buffer_.empty() && !commit_error_); });
+            continue;
+        }
+        const auto deadline = first_buffered_time_ + max_commit_delay_;
+        if (std::chrono::steady_clock::now() < deadline) {
+            // Woken early by a new record or the destructor, the loop re-checks the deadline
+            committer_wakeup_.wait_until(lock, deadline);
+            continue;
+        }
+        try {
+            CommitLocked();
+        }
+        catch (...) {
+            // Reported by the next Commit() on the caller's thread
+            commit_error_ = std::current_exception();
+        }
+    }
+}
+
+void MutationLog::RethrowCommitError() {
+    if (commit_error_) {
+        // The committer retries the buffered records once the error is reported
+        committer_wakeup_.notify_one();
+        std::rethrow_exception(std::exchange(commit_error_, nullptr));
+    }
+}
+
+void MutationLog::CommitLocked() {
+    if (!buffer_.empty()) {
+        WriteAll(fd_, buffer_);
+        sync_pending_ = sync_policy_ != SyncPolicy::NEVER;
+    }
+    // A failed sync is retried by the next commit even when nothing new is buffered
+    if (sync_pending_) {
+        if (::fsync(fd_) != 0) {
+            throw std::runtime_error("Failed to sync the mutation log"s);
+        }
+        sync_pending_ = false;
+    }
+}
+
+size_t MutationLog::FindValidEnd(const std::string& data) {
+    std::string_view rest = data;
+    size_t valid_end = 0;
+    while (rest.size() >= RECORD_HEADER_SIZE) {
+        uint32_t size = 0;
+        uint32_t crc = 0;
+        uint8_t type = 0;
+        Get(rest, size);
+        Get(rest, crc);
+        Get(rest, type);
+        if (rest.size() < size || ComputeCrc(type, rest.substr(0, size)) != crc
+            || (type != static_cast<uint8_t>(RecordType::ADD_DOCUMENT) && type != static_cast<uint8_t>(RecordType::REMOVE_DOCUMENT))) {
+            break;
+        }
+        rest.remove_prefix(size);
+        valid_end = data.size() - rest.size();
+    }
+    return valid_end;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <exception>
+#include <cstdint>
+#include "document.h"
+
+class SearchServer;
+
+// Append-only log of AddDocument/RemoveDocument calls. Every record carries a CRC32,
+// a torn or corrupted tail left by a crash is cut off on the next open.
+// Records are buffered and written by group commits: when group_commit_bytes accumulate, at
+// most max_commit_delay after a record is logged, or on Commit(). A record is durable only once
+// a commit has written it (and synced it, unless the policy is NEVER); call Commit() when a
+// mutation must survive a crash before the caller goes on. Logging a record never fails because
+// of a commit: write and sync errors keep the records buffered and are thrown by Commit().
+class MutationLog {
+public:
+    enum class SyncPolicy {
+        NEVER,            // hand data to the OS, never fsync
+        ON_COMMIT,        // fsync after every group commit
+        EVERY_RECORD,     // commit and fsync after every record
+    };
+
+    explicit MutationLog(const std::string& path, SyncPolicy sync_policy = SyncPolicy::ON_COMMIT,
+        size_t group_commit_bytes = 1 << 20,
+        std::chrono::milliseconds max_commit_delay = std::chrono::milliseconds(10));
+
+    MutationLog(const MutationLog&) = delete;
+    MutationLog& operator=(const MutationLog&) = delete;
+
+    ~MutationLog();
+
+    void LogAddDocument(int document_id, std::string_view document, DocumentStatus status,
+        const std::vector<int>& ratings);
+
+    void LogRemoveDocument(int document_id);
+
+    // Writes all buffered records with a single write and syncs according to the policy.
+    // Rethrows a failure of an earlier commit, the records it could not write are retried
+    void Commit();
+
+    // Drops every record logged so far. Call once the state they describe is checkpointed elsewhere
+    void Truncate();
+
+    // Re-applies the valid prefix of the log at path, returns the number of applied records.
+    // Run it before SetMutationLog, otherwise every replayed mutation is logged again
+    static size_t Replay(const std::string& path, SearchServer& search_server);
+
+private:
+    enum class RecordType : uint8_t {
+        ADD_DOCUMENT = 1,
+        REMOVE_DOCUMENT = 2,
+    };
+
+    void AppendRecord(RecordType type, const std::string& payload);
+    void CommitLocked();
+
+    // Commits records that have waited for max_commit_delay_
+    void RunCommitter();
+
+    // Rethrows and clears the failure of a background commit, the mutex must be held
+    void RethrowCommitError();
+
+    static size_t FindValidEnd(const std::string& data);
+
+    const std::string path_;
+    const SyncPolicy sync_policy_;
+    const size_t group_commit_bytes_;
+    const std::chrono::milliseconds max_commit_delay_;
+    int fd_ = -1;
+
+    std::mutex mutex_;
+    std::string buffer_;
+    bool sync_pending_ = false; // written but not yet synced
+    std::chrono::steady_clock::time_point first_buffered_time_;
+    std::exception_ptr commit_error_;
+
+    std::condition_variable committer_wakeup_;
+    bool stopping_ = false;
+    std::thread committer_;
+};
@@ -3,11 +3,28 @@
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
+    SEARCH_METRIC_SCOPE(Metric::PROCESS_QUERIES);
     std::vector<std::vector<Document>> documents_lists(queries.size());
     std::transform(std::execution::par, queries.begin(), queries.end(), documents_lists.begin(), [&search_server](const std::string& query) {return search_server.FindTopDocuments(query); });
     return documents_lists;
 }
 
+std::vector<std::vector<Document>> ProcessQueries(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    QueryStatistics& statistics) {
+    SEARCH_METRIC_SCOPE(Metric::PROCESS_QUERIES);
+    std::vector<std::vector<Document>> documents_lists(queries.size());
+    std::transform(std::execution::par, queries.begin(), queries.end(), documents_lists.begin(), [&search_server, &statistics](const std::string& query) {
+        const auto start_time = QueryStatistics::Clock::now();
+        std::vector<Document> documents = search_server.FindTopDocuments(query);
+        const auto end_time = QueryStatistics::Clock::now();
+        statistics.Record(query, documents.size(), end_time - start_time, end_time);
+        return documents;
+        });
+    return documents_lists;
+}
+
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
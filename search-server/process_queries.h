@@ -6,11 +6,18 @@
 #include <list>
 #include <numeric>
 #include "search_server.h"
+#include "query_statistics.h"
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
 
+// Also records every query in statistics from the worker threads
+std::vector<std::vector<Document>> ProcessQueries(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries,
+    QueryStatistics& statistics);
+
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
\ No newline at end of file
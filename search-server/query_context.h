@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+
+// Deadline and cooperative cancellation for one query. The posting scan checks it between
+// blocks of postings and stops early; the documents scored so far are still ranked and returned.
+class QueryContext {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    QueryContext() = default;
+
+    explicit QueryContext(Clock::time_point deadline)
+        : deadline_(deadline)
+    {
+    }
+
+    void Cancel() {
+        cancelled_.store(true, std::memory_order_relaxed);
+    }
+
+    bool IsCancelled() const {
+        return cancelled_.load(std::memory_order_relaxed);
+    }
+
+    bool IsDeadlineExceeded() const {
+        return deadline_ != Clock::time_point::max() && Clock::now() >= deadline_;
+    }
+
+    // Checkpoint of the posting scan, remembers that the query was cut short
+    bool IsStopRequested() const {
+        if (IsCancelled() || IsDeadlineExceeded()) {
+            interrupted_.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    // True if a query run with this context returned partial results
+    bool WasInterrupted() const {
+        return interrupted_.load(std::memory_order_relaxed);
+    }
+
+private:
+    const Clock::time_point deadline_ = Clock::time_point::max();
+    std::atomic<bool> cancelled_ = false;
+    mutable std::atomic<bool> interrupted_ = false;
+};
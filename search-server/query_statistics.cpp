@@ -0,0 +1,260 @@
+#include "query_statistics.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include "string_processing.h"
+
+namespace {
+
+    uint64_t MixHash(uint64_t value) {
+        value += 0x9E3779B97F4A7C15ULL;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+        return value ^ (value >> 31);
+    }
+}
+
+std::ostream& operator<<(std::ostream& output, const QueryStatisticsSnapshot& snapshot) {
+    output << "window_ms="s << std::chrono::duration_cast<std::chrono::milliseconds>(snapshot.window).count()
+        << " queries="s << snapshot.query_count
+        << " no_result="s << snapshot.no_result_count
+        << " p50_ns="s << snapshot.latency.GetValueAtPercentile(50)
+        << " p99_ns="s << snapshot.latency.GetValueAtPercentile(99)
+        << " top_terms="s;
+    bool first = true;
+    for (const auto& [term, count] : snapshot.top_terms) {
+        if (!first) {
+            output << ',';
+        }
+        first = false;
+        output << term << ':' << count;
+    }
+    return output;
+}
+
+QueryStatistics::QueryStatistics(std::chrono::milliseconds interval, size_t interval_count)
+    : interval_ns_(std::chrono::duration_cast<std::chrono::nanoseconds>(interval).count())
+    , interval_count_(interval_count)
+    , intervals_(std::make_unique<Interval[]>(interval_count))
+    , candidates_(std::make_unique<Candidate[]>(CANDIDATE_COUNT))
+{
+    if (interval_ns_ <= 0 || interval_count == 0) {
+        throw std::invalid_argument("The statistics window must not be empty"s);
+    }
+}
+
+void QueryStatistics::Record(std::string_view raw_query, size_t result_count, std::chrono::nanoseconds latency) {
+    Record(raw_query, result_count, latency, Clock::now());
+}
+
+void QueryStatistics::Record(std::string_view raw_query, size_t result_count, std::chrono::nanoseconds latency, Clock::time_point now) {
+    Interval* interval = AcquireInterval(GetEpoch(now));
+    if (interval == nullptr) {
+        return;
+    }
+    interval->query_count.fetch_add(1, std::memory_order_relaxed);
+    if (result_count == 0) {
+        interval->no_result_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    const uint64_t latency_ns = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0));
+    interval->latency_buckets[LatencyHistogram::GetBucketIndex(latency_ns)].fetch_add(1, std::memory_order_relaxed);
+
+    for (std::string_view word : SplitIntoWords(raw_query)) {
+        if (!word.empty() && word[0] == '-') {
+            word.remove_prefix(1);
+        }
+        if (!word.empty()) {
+            RecordTerm(*interval, word);
+        }
+    }
+}
+
+QueryStatisticsSnapshot QueryStatistics::GetSnapshot(size_t top_term_count) const {
+    return GetSnapshot(top_term_count, Clock::now());
+}
+
+QueryStatisticsSnapshot QueryStatistics::GetSnapshot(size_t top_term_count, Clock::time_point now) const {
+    const int64_t current_epoch = GetEpoch(now);
+    const int64_t interval_count = static_cast<int64_t>(interval_count_);
+    std::vector<const Interval*> live_intervals;
+    for (size_t i = 0; i < interval_count_; ++i) {
+        const int64_t epoch = intervals_[i].epoch.load(std::memory_order_acquire);
+        if (epoch >= 0 && epoch <= current_epoch && current_epoch - epoch < interval_count) {
+            live_intervals.push_back(&intervals_[i]);
+        }
+    }
+
+    QueryStatisticsSnapshot snapshot;
+    snapshot.window = GetWindow();
+    for (const Interval* interval : live_intervals) {
+        snapshot.query_count += interval->query_count.load(std::memory_order_relaxed);
+        snapshot.no_result_count += interval->no_result_count.load(std::memory_order_relaxed);
+        for (size_t bucket = 0; bucket < LatencyHistogram::BUCKET_COUNT; ++bucket) {
+            const uint64_t count = interval->latency_buckets[bucket].load(std::memory_order_relaxed);
+            if (count != 0) {
+                snapshot.latency.Add(bucket, count);
+            }
+        }
+    }
+
+    std::vector<uint64_t> seen_hashes;
+    std::string term;
+    uint64_t hash = 0;
+    for (size_t i = 0; i < CANDIDATE_COUNT; ++i) {
+        if (!ReadCandidate(candidates_[i], term, hash)
+            || std::find(seen_hashes.begin(), seen_hashes.end(), hash) != seen_hashes.end()) {
+            continue;
+        }
+        seen_hashes.push_back(hash);
+
+        // Row sums over the window are upper bounds as well, take the tightest one
+        uint64_t count = UINT64_MAX;
+        for (size_t row = 0; row < SKETCH_DEPTH; ++row) {
+            uint64_t row_count = 0;
+            for (const Interval* interval : live_intervals) {
+                row_count += interval->sketch[row][GetSketchColumn(hash, row)].load(std::memory_order_relaxed);
+            }
+            count = std::min(count, row_count);
+        }
+        if (count != 0) {
+            snapshot.top_terms.push_back({ term, count });
+        }
+    }
+    std::sort(snapshot.top_terms.begin(), snapshot.top_terms.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.count > rhs.count || (lhs.count == rhs.count && lhs.term < rhs.term);
+        });
+    if (snapshot.top_terms.size() > top_term_count) {
+        snapshot.top_terms.resize(top_term_count);
+    }
+    return snapshot;
+}
+
+std::chrono::nanoseconds QueryStatistics::GetWindow() const {
+    return std::chrono::nanoseconds(interval_ns_ * static_cast<int64_t>(interval_count_));
+}
+
+int64_t QueryStatistics::GetEpoch(Clock::time_point now) const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count() / interval_ns_;
+}
+
+QueryStatistics::Interval* QueryStatistics::AcquireInterval(int64_t epoch) {
+    Interval& interval = intervals_[static_cast<size_t>(epoch) % interval_count_];
+    int64_t current = interval.epoch.load(std::memory_order_acquire);
+    while (current != epoch) {
+        if (current == RESETTING_EPOCH) {
+            std::this_thread::yield();
+            current = interval.epoch.load(std::memory_order_acquire);
+            continue;
+        }
+        if (current > epoch) {
+            return nullptr;
+        }
+        if (interval.epoch.compare_exchange_weak(current, RESETTING_EPOCH, std::memory_order_acq_rel)) {
+            interval.query_count.store(0, std::memory_order_relaxed);
+            interval.no_result_count.store(0, std::memory_order_relaxed);
+            for (auto& bucket : interval.latency_buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            for (auto& row : interval.sketch) {
+                for (auto& cell : row) {
+                    cell.store(0, std::memory_order_relaxed);
+                }
+            }
+            interval.epoch.store(epoch, std::memory_order_release);
+            return &interval;
+        }
+    }
+    return &interval;
+}
+
+void QueryStatistics::RecordTerm(Interval& interval, std::string_view term) {
+    const uint64_t hash = HashTerm(term);
+    for (size_t row = 0; row < SKETCH_DEPTH; ++row) {
+        interval.sketch[row][GetSketchColumn(hash, row)].fetch_add(1, std::memory_order_relaxed);
+    }
+    TrackCandidate(interval, term, hash);
+}
+
+void QueryStatistics::TrackCandidate(const Interval& interval, std::string_view term, uint64_t hash) {
+    // A term may replace the candidate that is least frequent in the current interval
+    Candidate* victim = nullptr;
+    uint64_t victim_hash = 0;
+    uint32_t victim_count = UINT32_MAX;
+    for (size_t probe = 0; probe < CANDIDATE_PROBE_COUNT; ++probe) {
+        Candidate& candidate = candidates_[(hash + probe) % CANDIDATE_COUNT];
+        uint64_t current = candidate.hash.load(std::memory_order_relaxed);
+        if (current == hash) {
+            return;
+        }
+        if (current == 0) {
+            if (candidate.hash.compare_exchange_strong(current, hash, std::memory_order_relaxed)) {
+                PublishCandidate(candidate, term, hash);
+                return;
+            }
+            if (current == hash) {
+                return;
+            }
+        }
+        const uint32_t count = EstimateTermCount(interval, current);
+        if (count < victim_count) {
+            victim = &candidate;
+            victim_hash = current;
+            victim_count = count;
+        }
+    }
+    if (victim != nullptr && EstimateTermCount(interval, hash) > victim_count
+        && victim->hash.compare_exchange_strong(victim_hash, hash, std::memory_order_relaxed)) {
+        PublishCandidate(*victim, term, hash);
+    }
+}
+
+void QueryStatistics::PublishCandidate(Candidate& candidate, std::string_view term, uint64_t hash) {
+    candidate.published.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::array<uint64_t, MAX_TERM_SIZE / 8> words = {};
+    const size_t size = term.size() < MAX_TERM_SIZE ? term.size() : MAX_TERM_SIZE;
+    std::copy_n(term.data(), size, reinterpret_cast<char*>(words.data()));
+    for (size_t i = 0; i < words.size(); ++i) {
+        candidate.term[i].store(words[i], std::memory_order_relaxed);
+    }
+    candidate.size.store(static_cast<uint32_t>(term.size()), std::memory_order_relaxed);
+    candidate.published.store(hash, std::memory_order_release);
+}
+
+bool QueryStatistics::ReadCandidate(const Candidate& candidate, std::string& term, uint64_t& hash) {
+    hash = candidate.published.load(std::memory_order_acquire);
+    if (hash == 0) {
+        return false;
+    }
+    std::array<uint64_t, MAX_TERM_SIZE / 8> words;
+    for (size_t i = 0; i < words.size(); ++i) {
+        words[i] = candidate.term[i].load(std::memory_order_relaxed);
+    }
+    const size_t size = candidate.size.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (candidate.published.load(std::memory_order_relaxed) != hash) {
+        return false;
+    }
+    term.assign(reinterpret_cast<const char*>(words.data()), size < MAX_TERM_SIZE ? size : MAX_TERM_SIZE);
+    // Two writers replacing the same slot may interleave, only a whole term matches its hash
+    return size > MAX_TERM_SIZE || HashTerm(term) == hash;
+}
+
+uint64_t QueryStatistics::HashTerm(std::string_view term) {
+    // 0 marks a free candidate slot
+    return std::max<uint64_t>(MixHash(std::hash<std::string_view>{}(term)), 1);
+}
+
+size_t QueryStatistics::GetSketchColumn(uint64_t hash, size_t row) {
+    return static_cast<size_t>(MixHash(hash + row) % SKETCH_WIDTH);
+}
+
+uint32_t QueryStatistics::EstimateTermCount(const Interval& interval, uint64_t hash) {
+    uint32_t count = UINT32_MAX;
+    for (size_t row = 0; row < SKETCH_DEPTH; ++row) {
+        count = std::min(count, interval.sketch[row][GetSketchColumn(hash, row)].load(std::memory_order_relaxed));
+    }
+    return count;
+}
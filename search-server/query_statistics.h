@@ -0,0 +1,94 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "metrics.h"
+
+using namespace std::string_literals;
+
+struct QueryStatisticsSnapshot {
+    struct TermCount {
+        std::string term;
+        uint64_t count = 0; // count-min estimate, never below the real count
+    };
+
+    std::chrono::nanoseconds window{};
+    uint64_t query_count = 0;
+    uint64_t no_result_count = 0;
+    LatencyHistogram latency;
+    std::vector<TermCount> top_terms; // most frequent first
+};
+
+std::ostream& operator<<(std::ostream& output, const QueryStatisticsSnapshot& snapshot);
+
+// Live query statistics over a sliding wall-clock window. The window is a ring of interval_count
+// buckets of atomic counters, so any number of threads record without locks; the only wait is
+// for the writer that clears an expired bucket when an interval starts. Query terms are counted
+// in a per-interval count-min sketch, and a small table of heavy-hitter candidates remembers
+// which terms to report.
+class QueryStatistics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static const size_t SKETCH_DEPTH = 4;
+    static const size_t SKETCH_WIDTH = 1024;
+    static const size_t CANDIDATE_COUNT = 256;
+    static const size_t CANDIDATE_PROBE_COUNT = 8;
+    static const size_t MAX_TERM_SIZE = 48; // longer terms are reported truncated
+
+    explicit QueryStatistics(std::chrono::milliseconds interval = std::chrono::seconds(1), size_t interval_count = 60);
+
+    void Record(std::string_view raw_query, size_t result_count, std::chrono::nanoseconds latency);
+    void Record(std::string_view raw_query, size_t result_count, std::chrono::nanoseconds latency, Clock::time_point now);
+
+    QueryStatisticsSnapshot GetSnapshot(size_t top_term_count = 10) const;
+    QueryStatisticsSnapshot GetSnapshot(size_t top_term_count, Clock::time_point now) const;
+
+    std::chrono::nanoseconds GetWindow() const;
+
+private:
+    struct Interval {
+        std::atomic<int64_t> epoch{ EMPTY_EPOCH };
+        std::atomic<uint64_t> query_count{ 0 };
+        std::atomic<uint64_t> no_result_count{ 0 };
+        std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKET_COUNT> latency_buckets = {};
+        std::array<std::array<std::atomic<uint32_t>, SKETCH_WIDTH>, SKETCH_DEPTH> sketch = {};
+    };
+
+    // The term is written seqlock-style: published holds the hash once the bytes are complete
+    struct Candidate {
+        std::atomic<uint64_t> hash{ 0 }; // 0 - free slot
+        std::atomic<uint64_t> published{ 0 };
+        std::atomic<uint32_t> size{ 0 };
+        std::array<std::atomic<uint64_t>, MAX_TERM_SIZE / 8> term = {};
+    };
+
+    static const int64_t EMPTY_EPOCH = -1;
+    static const int64_t RESETTING_EPOCH = -2;
+
+    int64_t GetEpoch(Clock::time_point now) const;
+
+    // Interval for the epoch, cleared if it still holds an expired one; nullptr if the slot has moved past it
+    Interval* AcquireInterval(int64_t epoch);
+
+    void RecordTerm(Interval& interval, std::string_view term);
+    void TrackCandidate(const Interval& interval, std::string_view term, uint64_t hash);
+    static void PublishCandidate(Candidate& candidate, std::string_view term, uint64_t hash);
+    // Term of a published candidate or false if it is being rewritten
+    static bool ReadCandidate(const Candidate& candidate, std::string& term, uint64_t& hash);
+
+    static uint64_t HashTerm(std::string_view term);
+    static size_t GetSketchColumn(uint64_t hash, size_t row);
+    static uint32_t EstimateTermCount(const Interval& interval, uint64_t hash);
+
+    const int64_t interval_ns_;
+    const size_t interval_count_;
+    std::unique_ptr<Interval[]> intervals_;
+    std::unique_ptr<Candidate[]> candidates_;
+};
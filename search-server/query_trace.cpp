@@ -0,0 +1,22 @@
+#include "query_trace.h"
+
+std::ostream& operator<<(std::ostream& output, const QueryTrace& trace) {
+    output << (trace.is_parallel ? "parallel"s : "sequential"s) << " query\n"s;
+    for (const auto& term : trace.plus_terms) {
+        output << "  +"s << term.term << " postings = "s << term.posting_count << ", idf = "s << term.inverse_document_freq << '\n';
+    }
+    for (const auto& term : trace.minus_terms) {
+        output << "  -"s << term.term << " postings = "s << term.posting_count << '\n';
+    }
+    output << "  postings scanned = "s << trace.postings_scanned
+        << ", filtered by predicate = "s << trace.postings_filtered << '\n'
+        << "  documents scored = "s << trace.documents_scored
+        << ", excluded by minus-words = "s << trace.documents_excluded
+        << ", returned = "s << trace.documents_returned << '\n'
+        << "  parse = "s << trace.parse_time.count()
+        << " ns, scoring = "s << trace.scoring_time.count()
+        << " ns, exclusion = "s << trace.exclusion_time.count()
+        << " ns, merge = "s << trace.merge_time.count()
+        << " ns, sort = "s << trace.sort_time.count() << " ns"s << '\n';
+    return output;
+}
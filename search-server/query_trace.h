@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std::string_literals;
+
+// What FindTopDocuments did for one query. Terms are copied: prefix-expanded ones would
+// otherwise point into the index and dangle once their last document is removed.
+struct QueryTrace {
+    struct TermTrace {
+        std::string term;
+        size_t posting_count = 0;
+        double inverse_document_freq = 0;
+    };
+
+    bool is_parallel = false;
+    std::vector<TermTrace> plus_terms;
+    std::vector<TermTrace> minus_terms;
+
+    size_t postings_scanned = 0;
+    size_t postings_filtered = 0;   // rejected by the predicate
+    size_t documents_scored = 0;    // distinct documents before minus-words
+    size_t documents_excluded = 0;  // dropped by minus-words
+    size_t documents_returned = 0;
+
+    std::chrono::nanoseconds parse_time{};
+    std::chrono::nanoseconds scoring_time{};
+    std::chrono::nanoseconds exclusion_time{};
+    std::chrono::nanoseconds merge_time{};
+    std::chrono::nanoseconds sort_time{};
+};
+
+std::ostream& operator<<(std::ostream& output, const QueryTrace& trace);
+
+// Adds the lifetime of the object to a trace stage; does nothing without a trace
+class TraceStageTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit TraceStageTimer(std::chrono::nanoseconds* stage_time)
+        : stage_time_(stage_time)
+    {
+        if (stage_time_) {
+            start_time_ = Clock::now();
+        }
+    }
+
+    TraceStageTimer(const TraceStageTimer&) = delete;
+    TraceStageTimer& operator=(const TraceStageTimer&) = delete;
+
+    ~TraceStageTimer() {
+        if (stage_time_) {
+            *stage_time_ += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_time_);
+        }
+    }
+
+private:
+    std::chrono::nanoseconds* const stage_time_;
+    Clock::time_point start_time_;
+};
@@ -2,19 +2,27 @@
 #include <vector>
 #include <deque>
 #include <string>
+#include <chrono>
 #include "document.h"
 #include "search_server.h"
+#include "query_statistics.h"
 
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server)
-        : search_server_(search_server), num_no_result_requests_(0), current_time_(0)
+    // statistics may be nullptr, otherwise it also receives every request and may be shared with other threads
+    explicit RequestQueue(const SearchServer& search_server, QueryStatistics* statistics = nullptr)
+        : search_server_(search_server), statistics_(statistics), num_no_result_requests_(0), current_time_(0)
     {
     }
 
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
+        const auto start_time = QueryStatistics::Clock::now();
         std::vector<Document> result = search_server_.FindTopDocuments(raw_query, document_predicate);
+        if (statistics_ != nullptr) {
+            const auto end_time = QueryStatistics::Clock::now();
+            statistics_->Record(raw_query, result.size(), end_time - start_time, end_time);
+        }
         ++current_time_;
 
         while (!requests_.empty() && min_in_day_ <= current_time_ - requests_.front().timestamp) {
@@ -49,6 +57,7 @@ private:
     const static int min_in_day_ = 1440;
 
     const SearchServer& search_server_;
+    QueryStatistics* statistics_;
     int num_no_result_requests_;
     uint64_t current_time_;
 };
@@ -0,0 +1,85 @@
+#include "scoring_kernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCORING_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+    using ScaleFunction = void (*)(const double*, const uint8_t*, size_t, double, double*);
+
+    void ScaleScalar(const double* term_freqs, const uint8_t* mask, size_t count, double idf, double* contributions) {
+        for (size_t i = 0; i < count; ++i) {
+            contributions[i] = mask[i] ? term_freqs[i] * idf : 0.0;
+        }
+    }
+
+#ifdef SCORING_KERNEL_X86
+
+    __attribute__((target("sse2")))
+    void ScaleSse2(const double* term_freqs, const uint8_t* mask, size_t count, double idf, double* contributions) {
+        const __m128d idf_vector = _mm_set1_pd(idf);
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2) {
+            // All bits set in a lane whose mask byte is non-zero
+            const __m128d lane_mask = _mm_castsi128_pd(_mm_set_epi64x(
+                -static_cast<int64_t>(mask[i + 1] != 0), -static_cast<int64_t>(mask[i] != 0)));
+            const __m128d product = _mm_mul_pd(_mm_loadu_pd(term_freqs + i), idf_vector);
+            _mm_storeu_pd(contributions + i, _mm_and_pd(product, lane_mask));
+        }
+        ScaleScalar(term_freqs + i, mask + i, count - i, idf, contributions + i);
+    }
+
+    __attribute__((target("avx2")))
+    void ScaleAvx2(const double* term_freqs, const uint8_t* mask, size_t count, double idf, double* contributions) {
+        const __m256d idf_vector = _mm256_set1_pd(idf);
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            int32_t mask_bytes;
+            __builtin_memcpy(&mask_bytes, mask + i, sizeof(mask_bytes));
+            // Widen four mask bytes to four 64-bit lanes: 0 -> 0, non-zero -> all ones
+            const __m128i is_zero = _mm_cmpeq_epi8(_mm_cvtsi32_si128(mask_bytes), zero);
+            const __m256i lane_mask = _mm256_cmpeq_epi64(_mm256_cvtepi8_epi64(is_zero), _mm256_setzero_si256());
+            const __m256d product = _mm256_mul_pd(_mm256_loadu_pd(term_freqs + i), idf_vector);
+            _mm256_storeu_pd(contributions + i, _mm256_and_pd(product, _mm256_castsi256_pd(lane_mask)));
+        }
+        ScaleScalar(term_freqs + i, mask + i, count - i, idf, contributions + i);
+    }
+
+#endif
+
+    ScaleFunction SelectScale() {
+#ifdef SCORING_KERNEL_X86
+        if (__builtin_cpu_supports("avx2")) {
+            return ScaleAvx2;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return ScaleSse2;
+        }
+#endif
+        return ScaleScalar;
+    }
+
+    const ScaleFunction scale_function = SelectScale();
+}
+
+void ScatterAddScores(const int* ordinals, const double* term_freqs, const uint8_t* mask,
+    size_t count, double idf, double* scores, uint8_t* matched) {
+
+    double contributions[POSTING_BLOCK_SIZE];
+    while (count > 0) {
+        const size_t block_size = count < POSTING_BLOCK_SIZE ? count : POSTING_BLOCK_SIZE;
+        scale_function(term_freqs, mask, block_size, idf, contributions);
+        // There is no scatter instruction below AVX-512, the write-back stays scalar
+        for (size_t i = 0; i < block_size; ++i) {
+            scores[ordinals[i]] += contributions[i];
+            matched[ordinals[i]] |= mask[i];
+        }
+        ordinals += block_size;
+        term_freqs += block_size;
+        mask += block_size;
+        count -= block_size;
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Number of postings handled by one call of the scoring kernel
+const size_t POSTING_BLOCK_SIZE = 256;
+
+// scores[ordinals[i]] += term_freqs[i] * idf for every i with mask[i] != 0,
+// matched[ordinals[i]] is set for the same postings. The write-back is branch-free: postings
+// with mask[i] == 0 add zero, so every scores[ordinals[i]] must be initialized
+void ScatterAddScores(const int* ordinals, const double* term_freqs, const uint8_t* mask,
+    size_t count, double idf, double* scores, uint8_t* matched);
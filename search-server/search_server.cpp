@@ -1,26 +1,30 @@
 #include "search_server.h"
 
-SearchServer::SearchServer(const std::string& stop_words) {
-    if (!SearchServer::IsValidWord(stop_words)) {
-        throw std::invalid_argument("Stop-words contain invalid characters"s);
-    }
-    for (std::string_view word : SplitIntoWords(stop_words)) {
-        stop_words_.insert(static_cast<std::string>(word));
-    }
+SearchServer::SearchServer(std::pmr::memory_resource* resource)
+    : storage_(resource)
+    , stop_words_(resource)
+    , documents_(resource)
+    , document_id_(resource)
+    , id_to_word_to_document_freqs_(resource)
+    , word_to_postings_(resource)
+    , ordinal_to_document_(resource)
+{
 }
 
-SearchServer::SearchServer(std::string_view stop_words) {
-    if (!SearchServer::IsValidWord(stop_words)) {
-        throw std::invalid_argument("Stop-words contain invalid characters"s);
-    }
-    for (std::string_view word : SplitIntoWords(stop_words)) {
-        stop_words_.insert(static_cast<std::string>(word));
-    }
+SearchServer::SearchServer(const std::string& stop_words, std::pmr::memory_resource* resource)
+    : SearchServer(std::string_view(stop_words), resource)
+{
+}
+
+SearchServer::SearchServer(std::string_view stop_words, std::pmr::memory_resource* resource)
+    : SearchServer(resource) {
+    AddStopWords(SplitIntoWords(stop_words), stop_words_);
 }
 
 
 void SearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status,
     const std::vector<int>& ratings) {
+    SEARCH_METRIC_SCOPE(Metric::ADD_DOCUMENT);
 
     if (document_id < 0) {
         throw std::invalid_argument("The document ID cannot be negative"s);
@@ -31,7 +35,7 @@ void SearchServer::AddDocument(int document_id, std::string_view document, Docum
     }
 
 
-    if (!SearchServer::IsValidWord(document)) {
+    if (!IsValidWord(document)) {
         throw std::invalid_argument("The text of the document contains invalid characters"s);
     }
 
@@ -39,13 +43,28 @@ void SearchServer::AddDocument(int document_id, std::string_view document, Docum
     storage_.emplace_back(document);
 
 
-    const std::vector<std::string_view> words = SearchServer::SplitIntoWordsNoStop(storage_.back());
+    const std::vector<std::string_view> words = SplitIntoWordsNoStop(storage_.back(), stop_words_);
     const double inv_word_count = 1.0 / words.size();
     for (std::string_view word : words) {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
         id_to_word_to_document_freqs_[document_id][word] += inv_word_count;
     }
-    documents_.emplace(document_id, DocumentData{ SearchServer::ComputeAverageRating(ratings), status });
+
+    const int ordinal = static_cast<int>(ordinal_to_document_.size());
+    for (const auto [word, term_freq] : id_to_word_to_document_freqs_[document_id]) {
+        PostingList& postings = word_to_postings_[word];
+        postings.ordinals.push_back(ordinal);
+        postings.term_freqs.push_back(term_freq);
+    }
+
+    const auto [document_it, _] = documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, ordinal });
+    ordinal_to_document_.push_back(&*document_it);
+
+    if (mutation_log_) {
+        mutation_log_->LogAddDocument(document_id, document, status, ratings);
+    }
+    if (standing_queries_) {
+        standing_queries_->OnAddDocument(document_id, id_to_word_to_document_freqs_.at(document_id), status, document_it->second.rating);
+    }
 }
 
 
@@ -62,10 +81,20 @@ int SearchServer::GetDocumentCount() const {
     return documents_.size();
 }
 
+int SearchServer::GetDocumentFrequency(std::string_view word) const {
+    const auto postings_it = word_to_postings_.find(word);
+    return postings_it == word_to_postings_.end() ? 0 : static_cast<int>(postings_it->second.ordinals.size());
+}
+
+void SearchServer::ValidateQuery(std::string_view raw_query) const {
+    SearchServer::ParseQuery(raw_query, false);
+}
+
 matched_data_and_status_t SearchServer::MatchDocument(std::string_view raw_query,
     int document_id) const {
+    SEARCH_METRIC_SCOPE(Metric::MATCH_DOCUMENT);
 
-    if (!SearchServer::IsValidWord(raw_query)) {
+    if (!IsValidWord(raw_query)) {
         throw std::invalid_argument("The request text contains invalid characters"s);
     }
 
@@ -75,59 +104,13 @@ matched_data_and_status_t SearchServer::MatchDocument(std::string_view raw_query
 
     const Query query = SearchServer::ParseQuery(raw_query);
 
-    for (std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            return { {}, documents_.at(document_id).status };
-        }
-    }
-    std::vector<std::string_view> matched_words;
-    for (std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_.at(word).count(document_id)) {
-            matched_words.push_back(word);
-        }
-    }
-
-
-    return { matched_words, documents_.at(document_id).status };
+    return { SearchServer::MatchQueryWords(query, document_id), documents_.at(document_id).status };
 }
 
+// A handful of query words is not worth parallel algorithms, the sorted intersection is used as is
 matched_data_and_status_t SearchServer::MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query,
     int document_id) const {
-
-    if (!document_id_.count(document_id)) {
-        throw std::out_of_range("The request document_id is out of range"s);
-    }
-
-    const Query query = SearchServer::ParseQuery(raw_query, false);
-
-    if (std::any_of(std::execution::par, query.minus_words.begin(),
-        query.minus_words.end(),
-        [this, document_id](std::string_view minus_word) {
-            return this->word_to_document_freqs_.count(minus_word) && this->word_to_document_freqs_.at(minus_word).count(document_id); })) {
-        return { {}, documents_.at(document_id).status };
-    }
-
-    std::vector<std::string_view> matched_words(query.plus_words.size());
-
-    auto copy_last = std::copy_if(std::execution::par,
-        query.plus_words.begin(),
-        query.plus_words.end(),
-        matched_words.begin(), [this, document_id](std::string_view plus_word) {
-            return this->word_to_document_freqs_.count(plus_word) && this->word_to_document_freqs_.at(plus_word).count(document_id); });
-
-
-    std::sort(matched_words.begin(), copy_last);
-    auto last = std::unique(matched_words.begin(), copy_last);
-    matched_words.erase(last, matched_words.end());
-
-
-    return { matched_words, documents_.at(document_id).status };
+    return SearchServer::MatchDocument(raw_query, document_id);
 }
 
 matched_data_and_status_t SearchServer::MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query,
@@ -135,77 +118,143 @@ matched_data_and_status_t SearchServer::MatchDocument(const std::execution::sequ
     return SearchServer::MatchDocument(raw_query, document_id);
 }
 
-std::set<int>::const_iterator SearchServer::begin() const {
-    return document_id_.cbegin();
+std::vector<matched_data_and_status_t> SearchServer::MatchDocuments(std::string_view raw_query,
+    const std::vector<int>& document_ids) const {
+    return SearchServer::MatchDocuments(std::execution::seq, raw_query, document_ids);
 }
 
-std::set<int>::const_iterator SearchServer::end() const {
-    return document_id_.cend();
+std::vector<matched_data_and_status_t> SearchServer::MatchDocuments(const std::execution::sequenced_policy& policy, std::string_view raw_query,
+    const std::vector<int>& document_ids) const {
+    return SearchServer::MatchDocumentsImpl(policy, raw_query, document_ids);
 }
 
-bool SearchServer::IsValidWord(std::string_view word) {
-    // A valid word must not contain special characters
-    return std::none_of(word.begin(), word.end(), [](char c) {
-        return c >= '\0' && c < ' ';
-        });
+std::vector<matched_data_and_status_t> SearchServer::MatchDocuments(const std::execution::parallel_policy& policy, std::string_view raw_query,
+    const std::vector<int>& document_ids) const {
+    return SearchServer::MatchDocumentsImpl(policy, raw_query, document_ids);
 }
 
-bool SearchServer::IsStopWord(std::string_view word) const {
-    return stop_words_.count(word) > 0;
-}
+template <typename ExecutionPolicy>
+std::vector<matched_data_and_status_t> SearchServer::MatchDocumentsImpl(const ExecutionPolicy& policy, std::string_view raw_query,
+    const std::vector<int>& document_ids) const {
+    SEARCH_METRIC_SCOPE(Metric::MATCH_DOCUMENT);
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view text) const {
-    std::vector<std::string_view> words;
-    for (std::string_view word : SplitIntoWords(text)) {
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+    // Checked up front: an exception escaping a parallel algorithm terminates the program
+    for (const int document_id : document_ids) {
+        if (!document_id_.count(document_id)) {
+            throw std::out_of_range("The request document_id is out of range"s);
         }
     }
-    return words;
+
+    const Query query = SearchServer::ParseQuery(raw_query);
+
+    std::vector<matched_data_and_status_t> results(document_ids.size());
+    std::transform(policy, document_ids.begin(), document_ids.end(), results.begin(),
+        [this, &query](int document_id) -> matched_data_and_status_t {
+            return { this->MatchQueryWords(query, document_id), this->documents_.at(document_id).status };
+        });
+    return results;
 }
 
-int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
-    if (ratings.empty()) {
-        return 0;
+namespace {
+
+    // Calls on_match(word) for every word of the sorted, unique words that is present in the
+    // document's term map, until on_match returns false. Both sides are sorted, so they are merged;
+    // a document much longer than the query is probed with lower_bound instead.
+    template <typename OnMatch>
+    void IntersectWithDocument(const std::pmr::map<std::string_view, double>& word_freqs,
+        const std::pmr::vector<std::string_view>& words, OnMatch on_match) {
+
+        if (words.empty() || word_freqs.empty()) {
+            return;
+        }
+
+        size_t probe_cost = 1;
+        while ((size_t{ 1 } << probe_cost) < word_freqs.size()) {
+            ++probe_cost;
+        }
+        if (words.size() * probe_cost < word_freqs.size()) {
+            for (std::string_view word : words) {
+                if (word_freqs.count(word) && !on_match(word)) {
+                    return;
+                }
+            }
+            return;
+        }
+
+        auto word_it = words.begin();
+        auto freq_it = word_freqs.begin();
+        while (word_it != words.end() && freq_it != word_freqs.end()) {
+            if (*word_it < freq_it->first) {
+                ++word_it;
+            }
+            else if (freq_it->first < *word_it) {
+                ++freq_it;
+            }
+            else {
+                if (!on_match(*word_it)) {
+                    return;
+                }
+                ++word_it;
+                ++freq_it;
+            }
+        }
     }
-    int rating_sum = std::accumulate(ratings.begin(), ratings.end(), 0);
-    return rating_sum / static_cast<int>(ratings.size());
 }
 
+std::vector<std::string_view> SearchServer::MatchQueryWords(const Query& query, int document_id) const {
+    const auto& word_freqs = SearchServer::GetWordFrequencies(document_id);
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) const {
-    if (text.empty()) {
-        throw std::invalid_argument("Query word is empty"s);
-    }
-    std::string_view word = text;
-    bool is_minus = false;
-    if (word[0] == '-') {
-        is_minus = true;
-        word = word.substr(1);
-    }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
-        throw std::invalid_argument("Query word is invalid");
+    bool has_minus_word = false;
+    IntersectWithDocument(word_freqs, query.minus_words, [&has_minus_word](std::string_view) {
+        has_minus_word = true;
+        return false;
+        });
+    if (has_minus_word) {
+        return {};
     }
 
-    return { word, is_minus, IsStopWord(word) };
+    std::vector<std::string_view> matched_words;
+    IntersectWithDocument(word_freqs, query.plus_words, [&matched_words](std::string_view word) {
+        matched_words.push_back(word);
+        return true;
+        });
+    return matched_words;
 }
 
+std::pmr::set<int>::const_iterator SearchServer::begin() const {
+    return document_id_.cbegin();
+}
 
-SearchServer::Query SearchServer::ParseQuery(std::string_view text, bool delete_copy) const {
+std::pmr::set<int>::const_iterator SearchServer::end() const {
+    return document_id_.cend();
+}
 
-    if (!SearchServer::IsValidWord(text)) {
+bool SearchServer::IsStopWord(std::string_view word) const {
+    return stop_words_.count(word) > 0;
+}
+
+
+SearchServer::Query SearchServer::ParseQuery(std::string_view text, bool delete_copy,
+    std::pmr::memory_resource* resource) const {
+    SEARCH_METRIC_SCOPE(Metric::PARSE_QUERY);
+
+    if (!IsValidWord(text)) {
         throw std::invalid_argument("The request text contains invalid characters"s);
     }
 
-    SearchServer::Query query;
-    auto splited_text = SplitIntoWords(text);
+    SearchServer::Query query(resource);
+    auto splited_text = SplitIntoWords(text, resource);
 
     query.plus_words.reserve(splited_text.size());
     query.minus_words.reserve(splited_text.size());
 
     for (std::string_view word : splited_text) {
-        const QueryWord query_word = SearchServer::ParseQueryWord(word);
-        if (!query_word.is_stop) {
+        const QueryWord query_word = ParseQueryWord(word);
+        // Prefix words expand to indexed words only, which are never stop words
+        if (query_word.is_prefix) {
+            SearchServer::ExpandPrefix(query_word.data, query_word.is_minus ? query.minus_words : query.plus_words);
+        }
+        else if (!SearchServer::IsStopWord(query_word.data)) {
             if (query_word.is_minus) {
                 query.minus_words.push_back(query_word.data);
             }
@@ -233,55 +282,170 @@ SearchServer::Query SearchServer::ParseQuery(std::string_view text, bool delete_
     return query;
 }
 
+void SearchServer::ExpandPrefix(std::string_view prefix, std::pmr::vector<std::string_view>& words) const {
+    // Keys are sorted, so the words with the prefix form a contiguous range
+    for (auto it = word_to_postings_.lower_bound(prefix); it != word_to_postings_.end() && it->first.substr(0, prefix.size()) == prefix; ++it) {
+        words.push_back(it->first);
+    }
+}
+
+size_t SearchServer::EstimateQueryScratchBytes(std::string_view raw_query) const {
+    using PlusPostings = std::pair<const PostingList*, double>;
+    // Split words and both word lists hold at most one entry per two characters of the query
+    const size_t word_count = raw_query.size() / 2 + 1;
+    return word_count * (3 * sizeof(std::string_view) + sizeof(PlusPostings))
+        + ordinal_to_document_.size() * (sizeof(double) + sizeof(uint8_t) + sizeof(int))
+        + 8 * alignof(std::max_align_t);
+}
+
 double SearchServer::ComputeWordInverseDocumentFreq(std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+    return log(GetDocumentCount() * 1.0 / word_to_postings_.at(word).ordinals.size());
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
+const std::pmr::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
     if (!id_to_word_to_document_freqs_.count(document_id)) {
-        static const std::map<std::string_view, double> void_map = {};
+        static const std::pmr::map<std::string_view, double> void_map = {};
         return void_map;
     }
     return id_to_word_to_document_freqs_.at(document_id);
 }
 
 void SearchServer::RemoveDocument(int document_id) {
+    SEARCH_METRIC_SCOPE(Metric::REMOVE_DOCUMENT);
     if (!document_id_.count(document_id)) {
         return;
     }
 
-    auto all_words_in_document = SearchServer::GetWordFrequencies(document_id);
-    for (const auto [word, freq] : all_words_in_document) {
-        word_to_document_freqs_[word].erase(document_id);
+    const int ordinal = documents_.at(document_id).ordinal;
+    for (const auto [word, freq] : id_to_word_to_document_freqs_.at(document_id)) {
+        const auto postings_it = word_to_postings_.find(word);
+        SearchServer::ErasePosting(postings_it->second, ordinal);
+        if (postings_it->second.ordinals.empty()) {
+            word_to_postings_.erase(postings_it);
+        }
     }
-
-    documents_.erase(document_id);
-
-    document_id_.erase(document_id);
-
-    id_to_word_to_document_freqs_.erase(document_id);
+    SearchServer::ReleaseOrdinal(ordinal);
+    SearchServer::EraseDocument(document_id);
 }
 
 void SearchServer::RemoveDocument(const std::execution::parallel_policy&, int document_id) {
+    SEARCH_METRIC_SCOPE(Metric::REMOVE_DOCUMENT);
     if (!document_id_.count(document_id)) {
         return;
     }
 
-    std::vector<const std::string_view*> words(SearchServer::GetWordFrequencies(document_id).size());
-    std::transform(std::execution::par, id_to_word_to_document_freqs_.at(document_id).begin(),
-        id_to_word_to_document_freqs_.at(document_id).end(),
-        words.begin(),
-        [](auto const& word) {return &word.first; });
-    std::for_each(std::execution::par, words.begin(), words.end(), [this, document_id](const std::string_view* word) {this->word_to_document_freqs_[*word].erase(document_id); });
+    // Every word has its own posting list, the lists are updated in parallel and the emptied ones erased after
+    const int ordinal = documents_.at(document_id).ordinal;
+    const auto& word_freqs = id_to_word_to_document_freqs_.at(document_id);
+    std::vector<PostingList*> posting_lists(word_freqs.size());
+    std::transform(std::execution::par, word_freqs.begin(), word_freqs.end(), posting_lists.begin(),
+        [this](const auto& word_freq) { return &this->word_to_postings_.find(word_freq.first)->second; });
+    std::for_each(std::execution::par, posting_lists.begin(), posting_lists.end(),
+        [ordinal](PostingList* postings) { SearchServer::ErasePosting(*postings, ordinal); });
+    for (const auto [word, freq] : word_freqs) {
+        const auto postings_it = word_to_postings_.find(word);
+        if (postings_it->second.ordinals.empty()) {
+            word_to_postings_.erase(postings_it);
+        }
+    }
+    SearchServer::ReleaseOrdinal(ordinal);
+    SearchServer::EraseDocument(document_id);
+}
 
-    documents_.erase(document_id);
+void SearchServer::ErasePosting(PostingList& postings, int ordinal) {
+    const auto position = std::lower_bound(postings.ordinals.begin(), postings.ordinals.end(), ordinal) - postings.ordinals.begin();
+    postings.ordinals.erase(postings.ordinals.begin() + position);
+    postings.term_freqs.erase(postings.term_freqs.begin() + position);
+}
 
+void SearchServer::ReleaseOrdinal(int ordinal) {
+    ordinal_to_document_[ordinal] = nullptr;
+    ++removed_ordinal_count_;
+    // Queries size their scratch arrays by the ordinal count, keep it within twice the live documents
+    if (removed_ordinal_count_ * 2 > ordinal_to_document_.size()) {
+        SearchServer::CompactOrdinals();
+    }
+}
+
+void SearchServer::CompactOrdinals() {
+    // Live documents keep their relative order, so the posting lists stay sorted
+    std::vector<int> new_ordinals(ordinal_to_document_.size(), -1);
+    size_t live_count = 0;
+    for (size_t ordinal = 0; ordinal < ordinal_to_document_.size(); ++ordinal) {
+        if (ordinal_to_document_[ordinal]) {
+            new_ordinals[ordinal] = static_cast<int>(live_count);
+            ordinal_to_document_[live_count++] = ordinal_to_document_[ordinal];
+        }
+    }
+    ordinal_to_document_.resize(live_count);
+    ordinal_to_document_.shrink_to_fit();
+    removed_ordinal_count_ = 0;
+
+    for (auto& [document_id, document] : documents_) {
+        document.ordinal = new_ordinals[document.ordinal];
+    }
+    for (auto& [word, postings] : word_to_postings_) {
+        for (int& ordinal : postings.ordinals) {
+            ordinal = new_ordinals[ordinal];
+        }
+    }
+}
+
+void SearchServer::EraseDocument(int document_id) {
+    documents_.erase(document_id);
     document_id_.erase(document_id);
 
+    // The registry needs the words once the document is gone
+    std::pmr::map<std::string_view, double> removed_words(id_to_word_to_document_freqs_.get_allocator().resource());
+    if (standing_queries_) {
+        removed_words = std::move(id_to_word_to_document_freqs_.at(document_id));
+    }
     id_to_word_to_document_freqs_.erase(document_id);
-}
 
+    if (mutation_log_) {
+        mutation_log_->LogRemoveDocument(document_id);
+    }
+    if (standing_queries_) {
+        standing_queries_->OnRemoveDocument(document_id, removed_words);
+    }
+}
 
 void SearchServer::RemoveDocument(const std::execution::sequenced_policy&, int document_id) {
     SearchServer::RemoveDocument(document_id);
 }
+
+void SearchServer::SetMutationLog(MutationLog* mutation_log) {
+    mutation_log_ = mutation_log;
+}
+
+void SearchServer::SetStandingQueries(StandingQueryRegistry* standing_queries) {
+    standing_queries_ = standing_queries;
+}
+
+void SearchServer::TraceQueryTerms(const Query& query, QueryTrace& trace) const {
+    for (std::string_view word : query.plus_words) {
+        const auto postings_it = word_to_postings_.find(word);
+        if (postings_it == word_to_postings_.end()) {
+            trace.plus_terms.push_back({ std::string(word), 0, 0.0 });
+        }
+        else {
+            trace.plus_terms.push_back({ std::string(word), postings_it->second.ordinals.size(), ComputeWordInverseDocumentFreq(word) });
+        }
+    }
+    for (std::string_view word : query.minus_words) {
+        const auto postings_it = word_to_postings_.find(word);
+        trace.minus_terms.push_back({ std::string(word), postings_it == word_to_postings_.end() ? 0 : postings_it->second.ordinals.size(), 0.0 });
+    }
+}
+
+void SearchServer::SortTopDocuments(std::vector<Document>& matched_documents, QueryTrace* trace) {
+    SEARCH_METRIC_SCOPE(Metric::SORT_DOCUMENTS);
+    TraceStageTimer timer(trace ? &trace->sort_time : nullptr);
+    std::sort(matched_documents.begin(), matched_documents.end(), IsRankedBefore);
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    if (trace) {
+        trace->documents_returned = matched_documents.size();
+    }
+}
@@ -10,9 +10,19 @@
 #include <execution>
 #include <string_view>
 #include <deque>
+#include <memory_resource>
+#include <atomic>
+#include <type_traits>
 #include "string_processing.h"
 #include "document.h"
 #include "concurrent_map.h"
+#include "scoring_kernel.h"
+#include "mutation_log.h"
+#include "standing_queries.h"
+#include "metrics.h"
+#include "query_trace.h"
+#include "memory_resources.h"
+#include "query_context.h"
 
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
@@ -22,12 +32,16 @@ using matched_data_and_status_t = std::tuple<std::vector<std::string_view>, Docu
 class SearchServer {
 public:
 
+    // Index containers allocate from resource, a pool resource keeps their nodes together.
     template <typename StringCollection>
-    explicit SearchServer(const StringCollection& stop_words);
+    explicit SearchServer(const StringCollection& stop_words,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
-    explicit SearchServer(const std::string& stop_words);
+    explicit SearchServer(const std::string& stop_words,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
-    explicit SearchServer(std::string_view stop_words);
+    explicit SearchServer(std::string_view stop_words,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource());
 
     void AddDocument(int document_id, std::string_view document, DocumentStatus status,
         const std::vector<int>& ratings);
@@ -39,6 +53,23 @@ public:
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
         Predicate predicate) const;
 
+    // Same as above, also fills trace with the parsed terms, counters and stage timings
+    template <typename Predicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+        Predicate predicate, QueryTrace& trace) const;
+    template <typename ExecutionPolicy, typename Predicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+        Predicate predicate, QueryTrace& trace) const;
+
+    // Stops scanning postings once the context is cancelled or past its deadline
+    // and ranks what was scored so far, see QueryContext::WasInterrupted
+    template <typename Predicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query,
+        Predicate predicate, const QueryContext& context) const;
+    template <typename ExecutionPolicy, typename Predicate>
+    std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+        Predicate predicate, const QueryContext& context) const;
+
     std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus set_status) const;
     template <typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query, DocumentStatus set_status) const;
@@ -49,6 +80,12 @@ public:
 
     int GetDocumentCount() const;
 
+    // Number of documents containing the word
+    int GetDocumentFrequency(std::string_view word) const;
+
+    // Throws std::invalid_argument for a query FindTopDocuments would reject
+    void ValidateQuery(std::string_view raw_query) const;
+
     matched_data_and_status_t MatchDocument(std::string_view raw_query,
         int document_id) const;
     matched_data_and_status_t MatchDocument(const std::execution::parallel_policy&, std::string_view raw_query,
@@ -56,118 +93,211 @@ public:
     matched_data_and_status_t MatchDocument(const std::execution::sequenced_policy&, std::string_view raw_query,
         int document_id) const;
 
-    std::set<int>::const_iterator begin() const;
+    // Parses the query once and matches it against every document, results follow document_ids
+    std::vector<matched_data_and_status_t> MatchDocuments(std::string_view raw_query,
+        const std::vector<int>& document_ids) const;
+    std::vector<matched_data_and_status_t> MatchDocuments(const std::execution::sequenced_policy&, std::string_view raw_query,
+        const std::vector<int>& document_ids) const;
+    std::vector<matched_data_and_status_t> MatchDocuments(const std::execution::parallel_policy&, std::string_view raw_query,
+        const std::vector<int>& document_ids) const;
+
+    std::pmr::set<int>::const_iterator begin() const;
 
-    std::set<int>::const_iterator end() const;
+    std::pmr::set<int>::const_iterator end() const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    const std::pmr::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
 
     void RemoveDocument(int document_id);
     void RemoveDocument(const std::execution::parallel_policy&, int document_id);
     void RemoveDocument(const std::execution::sequenced_policy&, int document_id);
 
+    // Successful mutations are recorded to the log, nullptr disables logging. Replay an existing
+    // log into the server before attaching it
+    void SetMutationLog(MutationLog* mutation_log);
+
+    // Mutations are reported to the registry, nullptr detaches it
+    void SetStandingQueries(StandingQueryRegistry* standing_queries);
 
 
 private:
     struct DocumentData {
         int rating;
         DocumentStatus status;
+        int ordinal;
     };
 
-    std::deque<std::string> storage_;
-    std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>> word_to_document_freqs_; //word - id - frequency 
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_id_;
-    std::map<int, std::map<std::string_view, double>> id_to_word_to_document_freqs_; // id - word - frequency 
+    // Postings of one word in increasing ordinal order, stored as parallel arrays for the scoring kernel
+    struct PostingList {
+        using allocator_type = std::pmr::polymorphic_allocator<int>;
 
-    static bool IsValidWord(std::string_view word);
+        explicit PostingList(const allocator_type& allocator)
+            : ordinals(allocator), term_freqs(allocator)
+        {
+        }
 
-    bool IsStopWord(std::string_view word) const;
+        PostingList(PostingList&& other, const allocator_type& allocator)
+            : ordinals(std::move(other.ordinals), allocator), term_freqs(std::move(other.term_freqs), allocator)
+        {
+        }
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
+        std::pmr::vector<int> ordinals;
+        std::pmr::vector<double> term_freqs;
+    };
 
-    static int ComputeAverageRating(const std::vector<int>& ratings);
+    explicit SearchServer(std::pmr::memory_resource* resource);
 
-    struct QueryWord {
-        std::string_view data;
-        bool is_minus;
-        bool is_stop;
-    };
+    std::pmr::deque<std::pmr::string> storage_;
+    std::pmr::set<std::pmr::string, std::less<>> stop_words_;
+    std::pmr::map<int, DocumentData> documents_;
+    std::pmr::set<int> document_id_;
+    std::pmr::map<int, std::pmr::map<std::string_view, double>> id_to_word_to_document_freqs_; // id - word - frequency 
+    std::pmr::map<std::string_view, PostingList> word_to_postings_; // word - ordinals and frequencies
+    std::pmr::vector<const std::pair<const int, DocumentData>*> ordinal_to_document_; // nullptr for removed documents
+    size_t removed_ordinal_count_ = 0;
+    MutationLog* mutation_log_ = nullptr;
+    StandingQueryRegistry* standing_queries_ = nullptr;
 
-    QueryWord ParseQueryWord(std::string_view text) const;
+    bool IsStopWord(std::string_view word) const;
 
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        explicit Query(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : plus_words(resource), minus_words(resource) {}
+
+        std::pmr::vector<std::string_view> plus_words;
+        std::pmr::vector<std::string_view> minus_words;
     };
 
-    Query ParseQuery(std::string_view text, bool delete_copy = true) const;
+    // The word lists of the query and parsing temporaries are allocated from resource
+    Query ParseQuery(std::string_view text, bool delete_copy = true,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+    // Appends the indexed words starting with prefix
+    void ExpandPrefix(std::string_view prefix, std::pmr::vector<std::string_view>& words) const;
 
     // Existence required
     double ComputeWordInverseDocumentFreq(std::string_view word) const;
 
+    static void ErasePosting(PostingList& postings, int ordinal);
+
+    // Frees the ordinal, renumbers the documents once most ordinals are free
+    void ReleaseOrdinal(int ordinal);
+    void CompactOrdinals();
+
+    // Drops the document itself after its postings are gone
+    void EraseDocument(int document_id);
+
+    // Scratch for parsing and scoring, the block grows to whatever prefix expansion and
+    // parallel scoring need beyond this
+    size_t EstimateQueryScratchBytes(std::string_view raw_query) const;
+
+    // trace and context may be nullptr
     template <typename Predicate>
-    std::vector<Document> FindAllDocuments(const Query& query, Predicate predicate) const;
+    std::vector<Document> FindTopDocumentsImpl(std::string_view raw_query, Predicate predicate,
+        QueryTrace* trace, const QueryContext* context) const;
     template <typename ExecutionPolicy, typename Predicate>
-    std::vector<Document> FindAllDocuments(const ExecutionPolicy& policy, const Query& query, Predicate predicate) const;
+    std::vector<Document> FindTopDocumentsImpl(const ExecutionPolicy& policy, std::string_view raw_query, Predicate predicate,
+        QueryTrace* trace, const QueryContext* context) const;
+
+    // Matched plus-words of a parsed query in sorted order, empty if a minus-word matches
+    std::vector<std::string_view> MatchQueryWords(const Query& query, int document_id) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<matched_data_and_status_t> MatchDocumentsImpl(const ExecutionPolicy& policy, std::string_view raw_query,
+        const std::vector<int>& document_ids) const;
+
+    void TraceQueryTerms(const Query& query, QueryTrace& trace) const;
+
+    static void SortTopDocuments(std::vector<Document>& matched_documents, QueryTrace* trace);
+
+    // Scoring temporaries come from scratch, only the result is allocated on the heap
+    template <typename Predicate>
+    std::vector<Document> FindAllDocuments(const Query& query, Predicate predicate,
+        QueryTrace* trace, const QueryContext* context, QueryScratch& scratch) const;
+    template <typename ExecutionPolicy, typename Predicate>
+    std::vector<Document> FindAllDocuments(const ExecutionPolicy& policy, const Query& query, Predicate predicate,
+        QueryTrace* trace, const QueryContext* context, QueryScratch& scratch) const;
 };
 
 template <typename StringCollection>
-SearchServer::SearchServer(const StringCollection& stop_words) {
-
-    for (const std::string& word : stop_words) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("Stop-words contain invalid characters"s);
-        }
+SearchServer::SearchServer(const StringCollection& stop_words, std::pmr::memory_resource* resource)
+    : SearchServer(resource) {
 
-        stop_words_.insert(word);
-    }
+    AddStopWords(stop_words, stop_words_);
 }
 
 template <typename Predicate>
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
     Predicate predicate) const {
+    return SearchServer::FindTopDocumentsImpl(raw_query, predicate, nullptr, nullptr);
+}
 
-    const Query query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(query, predicate);
-
-    const double epsilon = 1e-6;
-    std::sort(matched_documents.begin(), matched_documents.end(),
-        [epsilon](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < epsilon) {
-                return lhs.rating > rhs.rating;
-            }
-            return lhs.relevance > rhs.relevance;
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+    Predicate predicate) const {
+    return SearchServer::FindTopDocumentsImpl(policy, raw_query, predicate, nullptr, nullptr);
+}
 
-    return matched_documents;
+template <typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
+    Predicate predicate, QueryTrace& trace) const {
+    trace = QueryTrace{};
+    return SearchServer::FindTopDocumentsImpl(raw_query, predicate, &trace, nullptr);
 }
 
 template <typename ExecutionPolicy, typename Predicate>
 std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
-    Predicate predicate) const {
+    Predicate predicate, QueryTrace& trace) const {
+    trace = QueryTrace{};
+    trace.is_parallel = std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::parallel_policy>;
+    return SearchServer::FindTopDocumentsImpl(policy, raw_query, predicate, &trace, nullptr);
+}
 
-    const Query query = ParseQuery(raw_query);
-    auto matched_documents = FindAllDocuments(policy, query, predicate);
+template <typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query,
+    Predicate predicate, const QueryContext& context) const {
+    return SearchServer::FindTopDocumentsImpl(raw_query, predicate, nullptr, &context);
+}
 
-    const double epsilon = 1e-6;
-    std::sort(matched_documents.begin(), matched_documents.end(),
-        [epsilon](const Document& lhs, const Document& rhs) {
-            if (std::abs(lhs.relevance - rhs.relevance) < epsilon) {
-                return lhs.rating > rhs.rating;
-            }
-            return lhs.relevance > rhs.relevance;
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
-    }
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& policy, std::string_view raw_query,
+    Predicate predicate, const QueryContext& context) const {
+    return SearchServer::FindTopDocumentsImpl(policy, raw_query, predicate, nullptr, &context);
+}
 
+template <typename Predicate>
+std::vector<Document> SearchServer::FindTopDocumentsImpl(std::string_view raw_query,
+    Predicate predicate, QueryTrace* trace, const QueryContext* context) const {
+
+    QueryScratch scratch(EstimateQueryScratchBytes(raw_query));
+    Query query(scratch.GetResource());
+    {
+        TraceStageTimer timer(trace ? &trace->parse_time : nullptr);
+        query = ParseQuery(raw_query, true, scratch.GetResource());
+    }
+    if (trace) {
+        TraceQueryTerms(query, *trace);
+    }
+    auto matched_documents = FindAllDocuments(query, predicate, trace, context, scratch);
+    SortTopDocuments(matched_documents, trace);
     return matched_documents;
+}
 
+template <typename ExecutionPolicy, typename Predicate>
+std::vector<Document> SearchServer::FindTopDocumentsImpl(const ExecutionPolicy& policy, std::string_view raw_query,
+    Predicate predicate, QueryTrace* trace, const QueryContext* context) const {
+
+    QueryScratch scratch(EstimateQueryScratchBytes(raw_query));
+    Query query(scratch.GetResource());
+    {
+        TraceStageTimer timer(trace ? &trace->parse_time : nullptr);
+        query = ParseQuery(raw_query, true, scratch.GetResource());
+    }
+    if (trace) {
+        TraceQueryTerms(query, *trace);
+    }
+    auto matched_documents = FindAllDocuments(policy, query, predicate, trace, context, scratch);
+    SortTopDocuments(matched_documents, trace);
+    return matched_documents;
 }
 
 template <typename ExecutionPolicy>
@@ -182,71 +312,185 @@ std::vector<Document> SearchServer::FindTopDocuments(const ExecutionPolicy& poli
 }
 
 template <typename Predicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, Predicate predicate) const {
-    std::map<int, double> document_to_relevance;
+std::vector<Document> SearchServer::FindAllDocuments(const Query& query, Predicate predicate,
+    QueryTrace* trace, const QueryContext* context, QueryScratch& scratch) const {
+    SEARCH_METRIC_SCOPE(Metric::FIND_ALL_DOCUMENTS);
+    using PlusPostings = std::pair<const PostingList*, double>;
+    const size_t ordinal_count = ordinal_to_document_.size();
+
+    std::pmr::vector<PlusPostings> plus_postings(scratch.GetResource());
+    plus_postings.reserve(query.plus_words.size());
+    size_t posting_count = 0;
     for (std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+        const auto postings_it = word_to_postings_.find(word);
+        if (postings_it != word_to_postings_.end()) {
+            plus_postings.emplace_back(&postings_it->second, ComputeWordInverseDocumentFreq(word));
+            posting_count += postings_it->second.ordinals.size();
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-            const auto& document = documents_.at(document_id);
-            if (predicate(document_id, document.status, document.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+    }
+
+    // Only touched ordinals are read. The kernel adds to the score of every posting in a block,
+    // rejected ones add zero, so a score is zeroed the first time its ordinal shows up at all
+    double* scores = static_cast<double*>(scratch.GetResource()->allocate(ordinal_count * sizeof(double), alignof(double)));
+    std::pmr::vector<uint8_t> matched(ordinal_count, 0, scratch.GetResource());
+    std::pmr::vector<int> touched(scratch.GetResource());
+    touched.reserve(std::min(posting_count, ordinal_count));
+    uint8_t mask[POSTING_BLOCK_SIZE];
+
+    {
+        TraceStageTimer timer(trace ? &trace->scoring_time : nullptr);
+        bool stopped = false;
+        for (const auto& [postings, inverse_document_freq] : plus_postings) {
+            for (size_t begin = 0; begin < postings->ordinals.size(); begin += POSTING_BLOCK_SIZE) {
+                if (context && context->IsStopRequested()) {
+                    stopped = true;
+                    break;
+                }
+                const size_t block_size = std::min(POSTING_BLOCK_SIZE, postings->ordinals.size() - begin);
+                for (size_t i = 0; i < block_size; ++i) {
+                    const int ordinal = postings->ordinals[begin + i];
+                    const auto& [document_id, document] = *ordinal_to_document_[ordinal];
+                    mask[i] = predicate(document_id, document.status, document.rating) ? 1 : 0;
+                    if (!matched[ordinal]) {
+                        scores[ordinal] = 0.0;
+                        if (mask[i]) {
+                            touched.push_back(ordinal);
+                        }
+                    }
+                }
+                ScatterAddScores(postings->ordinals.data() + begin, postings->term_freqs.data() + begin, mask,
+                    block_size, inverse_document_freq, scores, matched.data());
+                if (trace) {
+                    trace->postings_scanned += block_size;
+                    trace->postings_filtered += block_size - std::count(mask, mask + block_size, 1);
+                }
+            }
+            if (stopped) {
+                break;
             }
         }
     }
 
-    for (std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
-            continue;
+    {
+        TraceStageTimer timer(trace ? &trace->exclusion_time : nullptr);
+        if (trace) {
+            trace->documents_scored = touched.size();
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-            document_to_relevance.erase(document_id);
+        for (std::string_view word : query.minus_words) {
+            const auto postings_it = word_to_postings_.find(word);
+            if (postings_it == word_to_postings_.end()) {
+                continue;
+            }
+            for (const int ordinal : postings_it->second.ordinals) {
+                matched[ordinal] = 0;
+            }
         }
     }
 
+    TraceStageTimer timer(trace ? &trace->merge_time : nullptr);
+    // Ordinal order keeps ties in insertion order
+    std::sort(touched.begin(), touched.end());
     std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back(
-            { document_id, relevance, documents_.at(document_id).rating });
+    matched_documents.reserve(touched.size());
+    for (const int ordinal : touched) {
+        if (matched[ordinal]) {
+            const auto& [document_id, document] = *ordinal_to_document_[ordinal];
+            matched_documents.push_back(
+                { document_id, scores[ordinal], document.rating });
+        }
+    }
+    if (trace) {
+        trace->documents_excluded = trace->documents_scored - matched_documents.size();
     }
     return matched_documents;
 }
 
 template <typename ExecutionPolicy, typename Predicate>
-std::vector<Document> SearchServer::FindAllDocuments(const ExecutionPolicy& policy, const Query& query, Predicate predicate) const {
-    ConcurrentMap<int, double> document_to_relevance(100);
-    std::for_each(policy,
-        query.plus_words.begin(), query.plus_words.end(),
-        [this, &predicate, &document_to_relevance](const std::string_view word) {
-            if (this->word_to_document_freqs_.count(word) != 0) {
+std::vector<Document> SearchServer::FindAllDocuments(const ExecutionPolicy& policy, const Query& query, Predicate predicate,
+    QueryTrace* trace, const QueryContext* context, QueryScratch& scratch) const {
+    // The blocked kernel is the sequential path, the concurrent map only pays off in parallel
+    if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, std::execution::sequenced_policy>) {
+        return SearchServer::FindAllDocuments(query, predicate, trace, context, scratch);
+    }
+    SEARCH_METRIC_SCOPE(Metric::FIND_ALL_DOCUMENTS);
+    // A document is scored at most once per plus-word, so the postings bound the number of entries
+    size_t posting_count = 0;
+    for (std::string_view word : query.plus_words) {
+        const auto postings_it = word_to_postings_.find(word);
+        if (postings_it != word_to_postings_.end()) {
+            posting_count += postings_it->second.ordinals.size();
+        }
+    }
+    ConcurrentMap<int, double> document_to_relevance(100, std::min(posting_count, documents_.size()),
+        scratch.GetResource(), scratch.GetSynchronizedResource());
+    std::atomic<size_t> postings_scanned = 0;
+    std::atomic<size_t> postings_filtered = 0;
+    std::atomic<size_t> documents_excluded = 0;
+
+    {
+        TraceStageTimer timer(trace ? &trace->scoring_time : nullptr);
+        std::for_each(policy,
+            query.plus_words.begin(), query.plus_words.end(),
+            [this, &predicate, &document_to_relevance, trace, context, &postings_scanned, &postings_filtered](const std::string_view word) {
+                const auto postings_it = this->word_to_postings_.find(word);
+                if (postings_it == this->word_to_postings_.end()) {
+                    return;
+                }
+                const PostingList& postings = postings_it->second;
                 const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                for (const auto [document_id, term_freq] : this->word_to_document_freqs_.at(word)) {
-                    const auto& document = this->documents_.at(document_id);
+                size_t filtered = 0;
+                for (size_t i = 0; i < postings.ordinals.size(); ++i) {
+                    if (context && i % POSTING_BLOCK_SIZE == 0 && context->IsStopRequested()) {
+                        break;
+                    }
+                    const auto& [document_id, document] = *this->ordinal_to_document_[postings.ordinals[i]];
                     if (predicate(document_id, document.status, document.rating)) {
-                        document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
+                        document_to_relevance[document_id].ref_to_value += postings.term_freqs[i] * inverse_document_freq;
+                    }
+                    else {
+                        ++filtered;
                     }
                 }
-            }
-        });
+                if (trace) {
+                    postings_scanned += postings.ordinals.size();
+                    postings_filtered += filtered;
+                }
+            });
+    }
 
-    std::for_each(policy,
-        query.minus_words.begin(), query.minus_words.end(),
-        [this, &predicate, &document_to_relevance](const std::string_view word) {
-            if (this->word_to_document_freqs_.count(word) != 0) {
-                for (const auto [document_id, _] : this->word_to_document_freqs_.at(word)) {
-                    document_to_relevance.Erase(document_id);
+    {
+        TraceStageTimer timer(trace ? &trace->exclusion_time : nullptr);
+        std::for_each(policy,
+            query.minus_words.begin(), query.minus_words.end(),
+            [this, &document_to_relevance, &documents_excluded](const std::string_view word) {
+                const auto postings_it = this->word_to_postings_.find(word);
+                if (postings_it == this->word_to_postings_.end()) {
+                    return;
                 }
-            }
-        });
+                size_t excluded = 0;
+                for (const int ordinal : postings_it->second.ordinals) {
+                    excluded += document_to_relevance.Erase(this->ordinal_to_document_[ordinal]->first);
+                }
+                documents_excluded += excluded;
+            });
+    }
 
-    auto final_map = document_to_relevance.BuildOrdinaryMap();
+    TraceStageTimer timer(trace ? &trace->merge_time : nullptr);
     std::vector<Document> matched_documents;
-    matched_documents.reserve(final_map.size());
-    for (const auto [document_id, relevance] : final_map) {
+    matched_documents.reserve(document_to_relevance.GetSize());
+    document_to_relevance.ForEach([this, &matched_documents](int document_id, double relevance) {
         matched_documents.push_back(
             { document_id, relevance, documents_.at(document_id).rating });
+        });
+    // Buckets are walked in hash order, id order keeps ties as they were
+    std::sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
+        return lhs.id < rhs.id;
+        });
+    if (trace) {
+        trace->postings_scanned = postings_scanned;
+        trace->postings_filtered = postings_filtered;
+        trace->documents_excluded = documents_excluded;
+        trace->documents_scored = matched_documents.size() + documents_excluded;
     }
     return matched_documents;
-}
\ No newline at end of file
+}
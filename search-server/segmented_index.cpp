@@ -0,0 +1,363 @@
+#include "segmented_index.h"
+
+SegmentedIndex::SegmentedIndex(const std::string& stop_words, size_t segment_capacity, size_t max_segment_count)
+    : SegmentedIndex(std::string_view(stop_words), segment_capacity, max_segment_count)
+{
+}
+
+SegmentedIndex::SegmentedIndex(std::string_view stop_words, size_t segment_capacity, size_t max_segment_count)
+    : SegmentedIndex(SplitIntoWords(stop_words), segment_capacity, max_segment_count)
+{
+}
+
+SegmentedIndex::~SegmentedIndex() {
+    {
+        std::lock_guard guard(merger_mutex_);
+        stopping_ = true;
+    }
+    merger_wakeup_.notify_all();
+    merger_.join();
+}
+
+void SegmentedIndex::AddDocument(int document_id, std::string_view document, DocumentStatus status,
+    const std::vector<int>& ratings) {
+
+    if (document_id < 0) {
+        throw std::invalid_argument("The document ID cannot be negative"s);
+    }
+    if (!IsValidWord(document)) {
+        throw std::invalid_argument("The text of the document contains invalid characters"s);
+    }
+
+    std::map<std::string_view, double> word_freqs;
+    const std::vector<std::string_view> words = SplitIntoWordsNoStop(document, stop_words_);
+    const double inv_word_count = 1.0 / words.size();
+    for (std::string_view word : words) {
+        word_freqs[word] += inv_word_count;
+    }
+    const int rating = ComputeAverageRating(ratings);
+
+    std::shared_ptr<const SegmentBuilder> frozen;
+    {
+        std::unique_lock lock(index_mutex_);
+        const bool exists = mutable_segment_.documents.count(document_id)
+            || std::any_of(frozen_segments_.begin(), frozen_segments_.end(), [document_id](const FrozenSegment& frozen) {
+                return frozen.builder->documents.count(document_id) && !frozen.removed.count(document_id);
+            })
+            || std::any_of(sealed_segments_.begin(), sealed_segments_.end(), [document_id](const SealedSegment& sealed) {
+                return sealed.segment->FindDocument(document_id) >= 0 && !sealed.removed.count(document_id);
+            });
+        if (exists) {
+            throw std::invalid_argument("A document with this id has already been added"s);
+        }
+
+        mutable_segment_.Add(document_id, { rating, status }, word_freqs);
+        for (const auto [word, _] : word_freqs) {
+            auto freq_it = document_freqs_.find(word);
+            if (freq_it == document_freqs_.end()) {
+                freq_it = document_freqs_.emplace(std::string(word), 0).first;
+            }
+            ++freq_it->second;
+        }
+        ++document_count_;
+
+        if (mutable_segment_.documents.size() >= segment_capacity_) {
+            frozen = FreezeMutableSegment();
+        }
+    }
+    if (frozen) {
+        SealFrozenSegment(frozen);
+        // Taking the merger mutex orders the notification after a concurrent predicate check
+        { std::lock_guard guard(merger_mutex_); }
+        merger_wakeup_.notify_one();
+    }
+}
+
+void SegmentedIndex::RemoveDocument(int document_id) {
+    std::unique_lock lock(index_mutex_);
+
+    std::vector<std::string> words;
+    if (mutable_segment_.documents.count(document_id)) {
+        const std::vector<std::string_view>& document_words = mutable_segment_.document_words.at(document_id);
+        words.assign(document_words.begin(), document_words.end());
+        for (std::string_view word : words) {
+            mutable_segment_.word_to_document_freqs.find(word)->second.erase(document_id);
+        }
+    }
+    else if (const auto frozen_it = std::find_if(frozen_segments_.begin(), frozen_segments_.end(), [document_id](const FrozenSegment& frozen) {
+            return frozen.builder->documents.count(document_id) && !frozen.removed.count(document_id);
+        }); frozen_it != frozen_segments_.end()) {
+        const std::vector<std::string_view>& document_words = frozen_it->builder->document_words.at(document_id);
+        words.assign(document_words.begin(), document_words.end());
+        frozen_it->removed.insert(document_id);
+    }
+    else {
+        const auto sealed_it = std::find_if(sealed_segments_.begin(), sealed_segments_.end(), [document_id](const SealedSegment& sealed) {
+            return sealed.segment->FindDocument(document_id) >= 0 && !sealed.removed.count(document_id);
+        });
+        if (sealed_it == sealed_segments_.end()) {
+            return;
+        }
+        const Segment& segment = *sealed_it->segment;
+        const int document = segment.FindDocument(document_id);
+        for (uint32_t i = segment.document_term_offsets[document]; i < segment.document_term_offsets[document + 1]; ++i) {
+            words.push_back(segment.terms.GetTerm(static_cast<int>(segment.document_terms[i])));
+        }
+        sealed_it->removed.insert(document_id);
+    }
+
+    for (const std::string& word : words) {
+        const auto freq_it = document_freqs_.find(word);
+        if (--freq_it->second == 0) {
+            document_freqs_.erase(freq_it);
+        }
+    }
+    --document_count_;
+
+    // Words of a mutable document are referenced by the segment's own keys, drop them last
+    if (mutable_segment_.documents.erase(document_id)) {
+        for (std::string_view word : mutable_segment_.document_words.at(document_id)) {
+            const auto word_it = mutable_segment_.word_to_document_freqs.find(word);
+            if (word_it->second.empty()) {
+                mutable_segment_.word_to_document_freqs.erase(word_it);
+            }
+        }
+        mutable_segment_.document_words.erase(document_id);
+    }
+}
+
+std::vector<Document> SegmentedIndex::FindTopDocuments(std::string_view raw_query, DocumentStatus set_status) const {
+    return FindTopDocuments(raw_query, [set_status](int document_id, DocumentStatus status, int rating) { return status == set_status; });
+}
+
+std::vector<Document> SegmentedIndex::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+int SegmentedIndex::GetDocumentCount() const {
+    std::shared_lock lock(index_mutex_);
+    return document_count_;
+}
+
+size_t SegmentedIndex::GetSegmentCount() const {
+    std::shared_lock lock(index_mutex_);
+    return sealed_segments_.size();
+}
+
+void SegmentedIndex::WaitForMerges() {
+    std::unique_lock lock(merger_mutex_);
+    merger_idle_.wait(lock, [this] { return !merging_ && !HasMergeWork(); });
+}
+
+void SegmentedIndex::SegmentBuilder::Add(int document_id, DocumentData data, const std::map<std::string_view, double>& word_freqs) {
+    std::vector<std::string_view>& words = document_words[document_id];
+    words.reserve(word_freqs.size());
+    for (const auto [word, term_freq] : word_freqs) {
+        auto word_it = word_to_document_freqs.find(word);
+        if (word_it == word_to_document_freqs.end()) {
+            word_it = word_to_document_freqs.emplace(std::string(word), std::map<int, double>{}).first;
+        }
+        word_it->second[document_id] = term_freq;
+        words.push_back(word_it->first);
+    }
+    documents.emplace(document_id, data);
+}
+
+SegmentedIndex::Segment::Segment(const SegmentBuilder& builder) {
+    std::vector<std::string_view> words;
+    words.reserve(builder.word_to_document_freqs.size());
+    term_offsets.reserve(builder.word_to_document_freqs.size() + 1);
+    term_offsets.push_back(0);
+    for (const auto& [word, document_freqs] : builder.word_to_document_freqs) {
+        words.push_back(word);
+        for (const auto [document_id, term_freq] : document_freqs) {
+            posting_ids.push_back(document_id);
+            posting_freqs.push_back(term_freq);
+        }
+        term_offsets.push_back(static_cast<uint32_t>(posting_ids.size()));
+    }
+    terms = TermDictionary(words.begin(), words.end());
+
+    document_ids.reserve(builder.documents.size());
+    documents.reserve(builder.documents.size());
+    document_term_offsets.reserve(builder.documents.size() + 1);
+    document_term_offsets.push_back(0);
+    for (const auto& [document_id, data] : builder.documents) {
+        document_ids.push_back(document_id);
+        documents.push_back(data);
+        // Ordinals follow the builder's sorted word order
+        for (std::string_view word : builder.document_words.at(document_id)) {
+            document_terms.push_back(static_cast<uint32_t>(std::lower_bound(words.begin(), words.end(), word) - words.begin()));
+        }
+        document_term_offsets.push_back(static_cast<uint32_t>(document_terms.size()));
+    }
+}
+
+int SegmentedIndex::Segment::FindTerm(std::string_view word) const {
+    return terms.FindTerm(word);
+}
+
+int SegmentedIndex::Segment::FindDocument(int document_id) const {
+    const auto it = std::lower_bound(document_ids.begin(), document_ids.end(), document_id);
+    return it != document_ids.end() && *it == document_id ? static_cast<int>(it - document_ids.begin()) : -1;
+}
+
+SegmentedIndex::Query SegmentedIndex::ParseQuery(std::string_view text) const {
+    if (!IsValidWord(text)) {
+        throw std::invalid_argument("The request text contains invalid characters"s);
+    }
+
+    Query query;
+    for (std::string_view word : SplitIntoWords(text)) {
+        const QueryWord query_word = ParseQueryWord(word);
+        if (query_word.is_prefix) {
+            (query_word.is_minus ? query.minus_prefixes : query.plus_prefixes).push_back(query_word.data);
+            continue;
+        }
+        if (stop_words_.count(query_word.data)) {
+            continue;
+        }
+        (query_word.is_minus ? query.minus_words : query.plus_words).push_back(query_word.data);
+    }
+
+    for (auto* words : { &query.plus_words, &query.minus_words }) {
+        std::sort(words->begin(), words->end());
+        words->erase(std::unique(words->begin(), words->end()), words->end());
+    }
+    return query;
+}
+
+void SegmentedIndex::ExpandPrefixes(Query& query) const {
+    if (query.plus_prefixes.empty() && query.minus_prefixes.empty()) {
+        return;
+    }
+    for (auto [prefixes, words] : { std::pair{ &query.plus_prefixes, &query.plus_words }, std::pair{ &query.minus_prefixes, &query.minus_words } }) {
+        // A segment may still hold words of removed documents, the live ones have a document count
+        const auto add_live_word = [this, words = words](std::string_view word) {
+            const auto it = document_freqs_.find(word);
+            if (it != document_freqs_.end()) {
+                words->push_back(it->first);
+            }
+        };
+        const auto add_builder_words = [&add_live_word](const SegmentBuilder& builder, std::string_view prefix) {
+            for (auto it = builder.word_to_document_freqs.lower_bound(prefix);
+                it != builder.word_to_document_freqs.end() && std::string_view(it->first).substr(0, prefix.size()) == prefix; ++it) {
+                add_live_word(it->first);
+            }
+        };
+        for (std::string_view prefix : *prefixes) {
+            add_builder_words(mutable_segment_, prefix);
+            for (const FrozenSegment& frozen : frozen_segments_) {
+                add_builder_words(*frozen.builder, prefix);
+            }
+            for (const SealedSegment& sealed : sealed_segments_) {
+                sealed.segment->terms.ForEachWithPrefix(prefix, [&add_live_word](std::string_view term, int) {
+                    add_live_word(term);
+                });
+            }
+        }
+        prefixes->clear();
+        std::sort(words->begin(), words->end());
+        words->erase(std::unique(words->begin(), words->end()), words->end());
+    }
+}
+
+double SegmentedIndex::ComputeWordInverseDocumentFreq(std::string_view word) const {
+    return log(document_count_ * 1.0 / document_freqs_.find(word)->second);
+}
+
+std::shared_ptr<const SegmentedIndex::SegmentBuilder> SegmentedIndex::FreezeMutableSegment() {
+    // Moving the maps keeps their nodes, so the document word views stay valid
+    auto builder = std::make_shared<const SegmentBuilder>(std::move(mutable_segment_));
+    mutable_segment_ = SegmentBuilder{};
+    frozen_segments_.push_back({ builder, {} });
+    return builder;
+}
+
+void SegmentedIndex::SealFrozenSegment(const std::shared_ptr<const SegmentBuilder>& builder) {
+    auto segment = std::make_shared<const Segment>(*builder);
+
+    std::unique_lock lock(index_mutex_);
+    const auto frozen_it = std::find_if(frozen_segments_.begin(), frozen_segments_.end(), [&builder](const FrozenSegment& frozen) {
+        return frozen.builder == builder;
+    });
+    // Documents removed while the segment was built
+    sealed_segments_.push_back({ std::move(segment), std::move(frozen_it->removed) });
+    frozen_segments_.erase(frozen_it);
+}
+
+bool SegmentedIndex::HasMergeWork() const {
+    std::shared_lock lock(index_mutex_);
+    return sealed_segments_.size() > max_segment_count_;
+}
+
+void SegmentedIndex::RunMerger() {
+    std::unique_lock merger_lock(merger_mutex_);
+    while (true) {
+        merger_wakeup_.wait(merger_lock, [this] { return stopping_ || HasMergeWork(); });
+        if (stopping_) {
+            return;
+        }
+        merging_ = true;
+        merger_lock.unlock();
+
+        // Take the two smallest segments, they are immutable so the merge runs without the index lock
+        std::vector<SealedSegment> sources;
+        {
+            std::shared_lock lock(index_mutex_);
+            std::vector<SealedSegment> by_size = sealed_segments_;
+            std::partial_sort(by_size.begin(), by_size.begin() + 2, by_size.end(), [](const SealedSegment& lhs, const SealedSegment& rhs) {
+                return lhs.segment->document_ids.size() - lhs.removed.size() < rhs.segment->document_ids.size() - rhs.removed.size();
+            });
+            sources.assign(by_size.begin(), by_size.begin() + 2);
+        }
+
+        SegmentBuilder builder;
+        for (const SealedSegment& source : sources) {
+            const Segment& segment = *source.segment;
+            // Decode the dictionary once instead of per document
+            std::vector<std::string> terms;
+            terms.reserve(segment.terms.GetTermCount());
+            segment.terms.ForEachWithPrefix({}, [&terms](std::string_view term, int) {
+                terms.emplace_back(term);
+                });
+            for (size_t document = 0; document < segment.document_ids.size(); ++document) {
+                const int document_id = segment.document_ids[document];
+                if (source.removed.count(document_id)) {
+                    continue;
+                }
+                std::map<std::string_view, double> word_freqs;
+                for (uint32_t i = segment.document_term_offsets[document]; i < segment.document_term_offsets[document + 1]; ++i) {
+                    const uint32_t term = segment.document_terms[i];
+                    const auto posting_begin = segment.posting_ids.begin() + segment.term_offsets[term];
+                    const auto posting_end = segment.posting_ids.begin() + segment.term_offsets[term + 1];
+                    const auto posting = std::lower_bound(posting_begin, posting_end, document_id);
+                    word_freqs[terms[term]] = segment.posting_freqs[posting - segment.posting_ids.begin()];
+                }
+                builder.Add(document_id, segment.documents[document], word_freqs);
+            }
+        }
+        SealedSegment merged{ std::make_shared<const Segment>(builder), {} };
+
+        {
+            std::unique_lock lock(index_mutex_);
+            for (const SealedSegment& source : sources) {
+                const auto current = std::find_if(sealed_segments_.begin(), sealed_segments_.end(), [&source](const SealedSegment& sealed) {
+                    return sealed.segment == source.segment;
+                });
+                // Documents removed while the merge was running
+                for (const int document_id : current->removed) {
+                    if (!source.removed.count(document_id)) {
+                        merged.removed.insert(document_id);
+                    }
+                }
+                sealed_segments_.erase(current);
+            }
+            sealed_segments_.push_back(std::move(merged));
+        }
+
+        merger_lock.lock();
+        merging_ = false;
+        merger_idle_.notify_all();
+    }
+}
@@ -0,0 +1,259 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "document.h"
+#include "string_processing.h"
+#include "search_server.h"
+#include "term_dictionary.h"
+
+using namespace std::string_literals;
+
+// Index split into segments: new documents go to a small mutable segment which is sealed
+// into an immutable compact segment once full. A background thread merges sealed segments
+// and drops removed documents. Relevance is the same TF-IDF as in SearchServer with IDF
+// computed over the whole index.
+class SegmentedIndex {
+public:
+    template <typename StringCollection>
+    explicit SegmentedIndex(const StringCollection& stop_words, size_t segment_capacity = 4096, size_t max_segment_count = 8);
+
+    explicit SegmentedIndex(const std::string& stop_words, size_t segment_capacity = 4096, size_t max_segment_count = 8);
+
+    explicit SegmentedIndex(std::string_view stop_words, size_t segment_capacity = 4096, size_t max_segment_count = 8);
+
+    SegmentedIndex(const SegmentedIndex&) = delete;
+    SegmentedIndex& operator=(const SegmentedIndex&) = delete;
+
+    ~SegmentedIndex();
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status,
+        const std::vector<int>& ratings);
+
+    void RemoveDocument(int document_id);
+
+    template <typename Predicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, Predicate predicate) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus set_status) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    int GetDocumentCount() const;
+
+    // Number of sealed segments
+    size_t GetSegmentCount() const;
+
+    // Blocks until the merger has nothing left to do
+    void WaitForMerges();
+
+private:
+    struct DocumentData {
+        int rating;
+        DocumentStatus status;
+    };
+
+    // Documents collected before sealing or merging
+    struct SegmentBuilder {
+        std::map<std::string, std::map<int, double>, std::less<>> word_to_document_freqs;
+        std::map<int, DocumentData> documents;
+        std::map<int, std::vector<std::string_view>> document_words;
+
+        void Add(int document_id, DocumentData data, const std::map<std::string_view, double>& word_freqs);
+    };
+
+    // Immutable segment, postings and forward lists are stored as flat arrays
+    struct Segment {
+        TermDictionary terms;
+        std::vector<uint32_t> term_offsets; // postings of term i are [term_offsets[i], term_offsets[i + 1])
+        std::vector<int> posting_ids;
+        std::vector<double> posting_freqs;
+
+        std::vector<int> document_ids; // sorted
+        std::vector<DocumentData> documents;
+        std::vector<uint32_t> document_term_offsets;
+        std::vector<uint32_t> document_terms; // term ordinals
+
+        explicit Segment(const SegmentBuilder& builder);
+
+        // Index of the term or -1
+        int FindTerm(std::string_view word) const;
+        // Index of the document or -1
+        int FindDocument(int document_id) const;
+    };
+
+    struct SealedSegment {
+        std::shared_ptr<const Segment> segment;
+        std::set<int> removed;
+    };
+
+    // A full mutable segment that stays searchable while its Segment is built outside the index lock
+    struct FrozenSegment {
+        std::shared_ptr<const SegmentBuilder> builder;
+        std::set<int> removed;
+    };
+
+    struct Query {
+        std::vector<std::string_view> plus_words;
+        std::vector<std::string_view> minus_words;
+        std::vector<std::string_view> plus_prefixes; // "word*" terms without the asterisk
+        std::vector<std::string_view> minus_prefixes;
+    };
+
+    Query ParseQuery(std::string_view text) const;
+
+    // Replaces prefixes with the live words starting with them, sealed segments are searched
+    // through their term dictionaries. The index lock must be held
+    void ExpandPrefixes(Query& query) const;
+
+    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+
+    // Moves the full mutable segment to the frozen ones, the index lock must be held
+    std::shared_ptr<const SegmentBuilder> FreezeMutableSegment();
+
+    // Builds the segment without the index lock, then replaces the frozen builder with it
+    void SealFrozenSegment(const std::shared_ptr<const SegmentBuilder>& builder);
+
+    void RunMerger();
+
+    bool HasMergeWork() const;
+
+    std::set<std::string, std::less<>> stop_words_;
+    const size_t segment_capacity_;
+    const size_t max_segment_count_;
+
+    mutable std::shared_mutex index_mutex_;
+    SegmentBuilder mutable_segment_;
+    std::vector<FrozenSegment> frozen_segments_;
+    std::vector<SealedSegment> sealed_segments_;
+    std::map<std::string, int, std::less<>> document_freqs_; // word - number of live documents
+    int document_count_ = 0;
+
+    std::mutex merger_mutex_;
+    std::condition_variable merger_wakeup_;
+    std::condition_variable merger_idle_;
+    bool merging_ = false;
+    bool stopping_ = false;
+    std::thread merger_;
+};
+
+template <typename StringCollection>
+SegmentedIndex::SegmentedIndex(const StringCollection& stop_words, size_t segment_capacity, size_t max_segment_count)
+    : segment_capacity_(std::max<size_t>(segment_capacity, 1))
+    , max_segment_count_(std::max<size_t>(max_segment_count, 1))
+{
+    AddStopWords(stop_words, stop_words_);
+    merger_ = std::thread([this] { RunMerger(); });
+}
+
+template <typename Predicate>
+std::vector<Document> SegmentedIndex::FindTopDocuments(std::string_view raw_query, Predicate predicate) const {
+    Query query = ParseQuery(raw_query);
+
+    std::shared_lock lock(index_mutex_);
+    ExpandPrefixes(query);
+    std::map<int, double> document_to_relevance;
+    std::map<int, int> document_to_rating;
+
+    for (std::string_view word : query.plus_words) {
+        if (document_freqs_.count(word) == 0) {
+            continue;
+        }
+        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+
+        // The mutable segment drops removed documents at once, frozen ones keep them until sealed
+        const auto add_builder_postings = [&](const SegmentBuilder& builder, const std::set<int>& removed) {
+            const auto word_it = builder.word_to_document_freqs.find(word);
+            if (word_it == builder.word_to_document_freqs.end()) {
+                return;
+            }
+            for (const auto [document_id, term_freq] : word_it->second) {
+                if (removed.count(document_id)) {
+                    continue;
+                }
+                const DocumentData& document = builder.documents.at(document_id);
+                if (predicate(document_id, document.status, document.rating)) {
+                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
+                    document_to_rating[document_id] = document.rating;
+                }
+            }
+        };
+        add_builder_postings(mutable_segment_, {});
+        for (const FrozenSegment& frozen : frozen_segments_) {
+            add_builder_postings(*frozen.builder, frozen.removed);
+        }
+
+        for (const SealedSegment& sealed : sealed_segments_) {
+            const Segment& segment = *sealed.segment;
+            const int term = segment.FindTerm(word);
+            if (term < 0) {
+                continue;
+            }
+            for (uint32_t i = segment.term_offsets[term]; i < segment.term_offsets[term + 1]; ++i) {
+                const int document_id = segment.posting_ids[i];
+                if (sealed.removed.count(document_id)) {
+                    continue;
+                }
+                const DocumentData& document = segment.documents[segment.FindDocument(document_id)];
+                if (predicate(document_id, document.status, document.rating)) {
+                    document_to_relevance[document_id] += segment.posting_freqs[i] * inverse_document_freq;
+                    document_to_rating[document_id] = document.rating;
+                }
+            }
+        }
+    }
+
+    for (std::string_view word : query.minus_words) {
+        const auto exclude_builder_postings = [&](const SegmentBuilder& builder, const std::set<int>& removed) {
+            const auto word_it = builder.word_to_document_freqs.find(word);
+            if (word_it == builder.word_to_document_freqs.end()) {
+                return;
+            }
+            for (const auto [document_id, _] : word_it->second) {
+                if (!removed.count(document_id)) {
+                    document_to_relevance.erase(document_id);
+                }
+            }
+        };
+        exclude_builder_postings(mutable_segment_, {});
+        for (const FrozenSegment& frozen : frozen_segments_) {
+            exclude_builder_postings(*frozen.builder, frozen.removed);
+        }
+        for (const SealedSegment& sealed : sealed_segments_) {
+            const Segment& segment = *sealed.segment;
+            const int term = segment.FindTerm(word);
+            if (term < 0) {
+                continue;
+            }
+            for (uint32_t i = segment.term_offsets[term]; i < segment.term_offsets[term + 1]; ++i) {
+                // A removed id may have been added again to a newer segment
+                if (!sealed.removed.count(segment.posting_ids[i])) {
+                    document_to_relevance.erase(segment.posting_ids[i]);
+                }
+            }
+        }
+    }
+    lock.unlock();
+
+    std::vector<Document> matched_documents;
+    matched_documents.reserve(document_to_relevance.size());
+    for (const auto [document_id, relevance] : document_to_relevance) {
+        matched_documents.push_back({ document_id, relevance, document_to_rating.at(document_id) });
+    }
+
+    std::sort(matched_documents.begin(), matched_documents.end(), IsRankedBefore);
+    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return matched_documents;
+}
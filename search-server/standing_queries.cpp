@@ -0,0 +1,262 @@
+#include "standing_queries.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include "search_server.h"
+#include "string_processing.h"
+
+namespace {
+
+    const double INFINITE_COUNT = std::numeric_limits<double>::infinity();
+
+    bool HaveSameDocuments(const std::vector<Document>& lhs, const std::vector<Document>& rhs) {
+        return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](const Document& left, const Document& right) {
+            return left.id == right.id;
+            });
+    }
+
+    void AddQueryToWords(int query_id, const std::vector<std::string>& words, std::map<std::string, std::vector<int>, std::less<>>& word_to_queries) {
+        for (const std::string& word : words) {
+            word_to_queries[word].push_back(query_id);
+        }
+    }
+
+    void RemoveQueryFromWords(int query_id, const std::vector<std::string>& words, std::map<std::string, std::vector<int>, std::less<>>& word_to_queries) {
+        for (const std::string& word : words) {
+            const auto word_it = word_to_queries.find(word);
+            std::vector<int>& query_ids = word_it->second;
+            query_ids.erase(std::find(query_ids.begin(), query_ids.end(), query_id));
+            if (query_ids.empty()) {
+                word_to_queries.erase(word_it);
+            }
+        }
+    }
+
+    void CollectQueries(const std::pmr::map<std::string_view, double>& word_freqs, const std::map<std::string, std::vector<int>, std::less<>>& word_to_queries, std::set<int>& query_ids) {
+        for (const auto& [word, _] : word_freqs) {
+            const auto word_it = word_to_queries.find(word);
+            if (word_it != word_to_queries.end()) {
+                query_ids.insert(word_it->second.begin(), word_it->second.end());
+            }
+        }
+    }
+}
+
+StandingQueryRegistry::StandingQueryRegistry(const SearchServer& search_server, ResultsCallback callback, double max_idf_drift)
+    : search_server_(search_server), callback_(std::move(callback)), max_idf_drift_(max_idf_drift)
+{
+    if (max_idf_drift < 0) {
+        throw std::invalid_argument("The IDF drift threshold cannot be negative"s);
+    }
+}
+
+int StandingQueryRegistry::AddQuery(std::string_view raw_query, DocumentStatus status) {
+    search_server_.ValidateQuery(raw_query);
+
+    StandingQuery query;
+    query.raw_query = std::string(raw_query);
+    query.status = status;
+    for (std::string_view word : SplitIntoWords(raw_query)) {
+        const QueryWord query_word = ParseQueryWord(word);
+        // The words a prefix expands to change with the index
+        if (query_word.is_prefix) {
+            throw std::invalid_argument("Prefix words are not supported in standing queries"s);
+        }
+        (query_word.is_minus ? query.minus_words : query.plus_words).emplace_back(query_word.data);
+    }
+    for (auto* words : { &query.plus_words, &query.minus_words }) {
+        std::sort(words->begin(), words->end());
+        words->erase(std::unique(words->begin(), words->end()), words->end());
+    }
+
+    const int query_id = next_query_id_++;
+    AddQueryToWords(query_id, query.plus_words, plus_word_to_queries_);
+    AddQueryToWords(query_id, query.minus_words, minus_word_to_queries_);
+    query.min_document_count = min_document_counts_.emplace(-INFINITE_COUNT, query_id);
+    query.max_document_count = max_document_counts_.emplace(INFINITE_COUNT, query_id);
+
+    Evaluate(query_id, queries_.emplace(query_id, std::move(query)).first->second);
+    return query_id;
+}
+
+void StandingQueryRegistry::RemoveQuery(int query_id) {
+    const auto query_it = queries_.find(query_id);
+    if (query_it == queries_.end()) {
+        return;
+    }
+    StandingQuery& query = query_it->second;
+    RemoveQueryFromWords(query_id, query.plus_words, plus_word_to_queries_);
+    RemoveQueryFromWords(query_id, query.minus_words, minus_word_to_queries_);
+    min_document_counts_.erase(query.min_document_count);
+    max_document_counts_.erase(query.max_document_count);
+    for (const Document& document : query.results) {
+        const auto document_it = document_to_queries_.find(document.id);
+        document_it->second.erase(query_id);
+        if (document_it->second.empty()) {
+            document_to_queries_.erase(document_it);
+        }
+    }
+    queries_.erase(query_it);
+}
+
+const std::vector<Document>& StandingQueryRegistry::GetResults(int query_id) const {
+    return queries_.at(query_id).results;
+}
+
+size_t StandingQueryRegistry::GetQueryCount() const {
+    return queries_.size();
+}
+
+size_t StandingQueryRegistry::GetEvaluationCount() const {
+    return evaluation_count_;
+}
+
+void StandingQueryRegistry::OnAddDocument(int document_id, const std::pmr::map<std::string_view, double>& word_freqs,
+    DocumentStatus status, int rating) {
+    std::set<int> matched_queries;
+    std::set<int> excluded_queries;
+    CollectQueries(word_freqs, plus_word_to_queries_, matched_queries);
+    CollectQueries(word_freqs, minus_word_to_queries_, excluded_queries);
+
+    std::set<int> query_ids = matched_queries;
+    query_ids.insert(excluded_queries.begin(), excluded_queries.end());
+    CollectDriftedQueries(search_server_.GetDocumentCount(), query_ids);
+
+    for (const int query_id : query_ids) {
+        StandingQuery& query = queries_.at(query_id);
+        if (!UpdateDriftLimits(query_id, query)) {
+            Evaluate(query_id, query);
+            continue;
+        }
+        if (!matched_queries.count(query_id) || excluded_queries.count(query_id) || status != query.status) {
+            continue;
+        }
+
+        // Scored with the IDFs of the last evaluation, like the documents already in the results
+        double relevance = 0;
+        for (size_t i = 0; i < query.plus_words.size(); ++i) {
+            const auto word_it = word_freqs.find(query.plus_words[i]);
+            if (word_it != word_freqs.end() && query.inverse_document_freqs[i]) {
+                relevance += word_it->second * *query.inverse_document_freqs[i];
+            }
+        }
+        const Document document(document_id, relevance, rating);
+        const auto position = std::find_if(query.results.begin(), query.results.end(), [&document](const Document& result) {
+            return IsRankedBefore(document, result);
+            });
+        if (position == query.results.end() && query.results.size() >= static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT)) {
+            continue;
+        }
+        std::vector<Document> results = query.results;
+        results.insert(results.begin() + (position - query.results.begin()), document);
+        if (results.size() > static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT)) {
+            results.pop_back();
+        }
+        SetResults(query_id, query, std::move(results));
+    }
+}
+
+void StandingQueryRegistry::OnRemoveDocument(int document_id, const std::pmr::map<std::string_view, double>& word_freqs) {
+    std::set<int> query_ids;
+    const auto document_it = document_to_queries_.find(document_id);
+    if (document_it != document_to_queries_.end()) {
+        query_ids = document_it->second;
+    }
+    // A removed document that was not in the results only moves the IDFs
+    CollectQueries(word_freqs, plus_word_to_queries_, query_ids);
+    CollectDriftedQueries(search_server_.GetDocumentCount(), query_ids);
+
+    for (const int query_id : query_ids) {
+        StandingQuery& query = queries_.at(query_id);
+        const bool has_document = std::any_of(query.results.begin(), query.results.end(), [document_id](const Document& document) {
+            return document.id == document_id;
+            });
+        if (has_document || !UpdateDriftLimits(query_id, query)) {
+            Evaluate(query_id, query);
+        }
+    }
+}
+
+void StandingQueryRegistry::Evaluate(int query_id, StandingQuery& query) {
+    ++evaluation_count_;
+    query.inverse_document_freqs.clear();
+    for (const std::string& word : query.plus_words) {
+        query.inverse_document_freqs.push_back(ComputeInverseDocumentFreq(word));
+    }
+    UpdateDriftLimits(query_id, query);
+    SetResults(query_id, query, search_server_.FindTopDocuments(query.raw_query, query.status));
+}
+
+bool StandingQueryRegistry::UpdateDriftLimits(int query_id, StandingQuery& query) {
+    bool has_inverse_document_freq = false;
+    double min_drift = 0;
+    double max_drift = 0;
+    for (size_t i = 0; i < query.plus_words.size(); ++i) {
+        const std::optional<double> inverse_document_freq = ComputeInverseDocumentFreq(query.plus_words[i]);
+        const std::optional<double>& evaluated = query.inverse_document_freqs[i];
+        if (inverse_document_freq.has_value() != evaluated.has_value()) {
+            return false;
+        }
+        if (!inverse_document_freq) {
+            continue;
+        }
+        const double drift = *inverse_document_freq - *evaluated;
+        if (std::abs(drift) > max_idf_drift_) {
+            return false;
+        }
+        min_drift = has_inverse_document_freq ? std::min(min_drift, drift) : drift;
+        max_drift = has_inverse_document_freq ? std::max(max_drift, drift) : drift;
+        has_inverse_document_freq = true;
+    }
+
+    // A new document count shifts every IDF by the same log(new_count / count)
+    double min_document_count = -INFINITE_COUNT;
+    double max_document_count = INFINITE_COUNT;
+    if (has_inverse_document_freq) {
+        const double document_count = search_server_.GetDocumentCount();
+        min_document_count = document_count * std::exp(-max_idf_drift_ - min_drift);
+        max_document_count = document_count * std::exp(max_idf_drift_ - max_drift);
+    }
+    min_document_counts_.erase(query.min_document_count);
+    max_document_counts_.erase(query.max_document_count);
+    query.min_document_count = min_document_counts_.emplace(min_document_count, query_id);
+    query.max_document_count = max_document_counts_.emplace(max_document_count, query_id);
+    return true;
+}
+
+void StandingQueryRegistry::SetResults(int query_id, StandingQuery& query, std::vector<Document> results) {
+    const bool is_changed = !HaveSameDocuments(query.results, results);
+    for (const Document& document : query.results) {
+        const auto document_it = document_to_queries_.find(document.id);
+        document_it->second.erase(query_id);
+        if (document_it->second.empty()) {
+            document_to_queries_.erase(document_it);
+        }
+    }
+    query.results = std::move(results);
+    for (const Document& document : query.results) {
+        document_to_queries_[document.id].insert(query_id);
+    }
+    if (is_changed && callback_) {
+        callback_(query_id, query.results);
+    }
+}
+
+void StandingQueryRegistry::CollectDriftedQueries(int document_count, std::set<int>& query_ids) const {
+    for (auto it = max_document_counts_.begin(); it != max_document_counts_.end() && it->first < document_count; ++it) {
+        query_ids.insert(it->second);
+    }
+    for (auto it = min_document_counts_.upper_bound(document_count); it != min_document_counts_.end(); ++it) {
+        query_ids.insert(it->second);
+    }
+}
+
+std::optional<double> StandingQueryRegistry::ComputeInverseDocumentFreq(std::string_view word) const {
+    const int document_freq = search_server_.GetDocumentFrequency(word);
+    if (document_freq == 0) {
+        return std::nullopt;
+    }
+    return std::log(search_server_.GetDocumentCount() * 1.0 / document_freq);
+}
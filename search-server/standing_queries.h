@@ -0,0 +1,86 @@
+#pragma once
+#include <functional>
+#include <map>
+#include <memory_resource>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "document.h"
+
+class SearchServer;
+
+// Saved queries whose top documents are kept up to date while documents are added and removed.
+// Attach with SearchServer::SetStandingQueries. A mutation only touches the queries that share
+// a word with the document: a new document is scored against them with the IDFs of their last
+// full evaluation, and a query is evaluated again when a document of its results is removed or
+// the IDF of one of its plus-words has moved by more than max_idf_drift since then.
+class StandingQueryRegistry {
+public:
+    // Called with the new results of a query whenever its result documents change, starting with
+    // the first evaluation. It runs inside AddDocument/RemoveDocument and must not modify the server
+    using ResultsCallback = std::function<void(int query_id, const std::vector<Document>& results)>;
+
+    // max_idf_drift is in natural-log units, 0 keeps the results exact
+    StandingQueryRegistry(const SearchServer& search_server, ResultsCallback callback, double max_idf_drift = 0.02);
+
+    StandingQueryRegistry(const StandingQueryRegistry&) = delete;
+    StandingQueryRegistry& operator=(const StandingQueryRegistry&) = delete;
+
+    // Evaluates the query and returns its id. Prefix words are not supported
+    int AddQuery(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL);
+
+    void RemoveQuery(int query_id);
+
+    const std::vector<Document>& GetResults(int query_id) const;
+
+    size_t GetQueryCount() const;
+
+    // Number of full evaluations, including the initial ones
+    size_t GetEvaluationCount() const;
+
+    // Called by SearchServer once a document is added or removed
+    void OnAddDocument(int document_id, const std::pmr::map<std::string_view, double>& word_freqs,
+        DocumentStatus status, int rating);
+    void OnRemoveDocument(int document_id, const std::pmr::map<std::string_view, double>& word_freqs);
+
+private:
+    struct StandingQuery {
+        std::string raw_query;
+        DocumentStatus status;
+        std::vector<std::string> plus_words;  // sorted
+        std::vector<std::string> minus_words; // sorted
+        std::vector<std::optional<double>> inverse_document_freqs; // of plus_words at the last evaluation, empty if absent
+        std::vector<Document> results;
+        // The document count alone can move the IDFs within these limits
+        std::multimap<double, int>::iterator min_document_count;
+        std::multimap<double, int>::iterator max_document_count;
+    };
+
+    // Runs the query against the server and reports the results if they changed
+    void Evaluate(int query_id, StandingQuery& query);
+
+    // Recomputes the document count limits, false if the IDFs have already drifted too far
+    bool UpdateDriftLimits(int query_id, StandingQuery& query);
+
+    void SetResults(int query_id, StandingQuery& query, std::vector<Document> results);
+
+    // Queries whose document count limits are crossed by document_count
+    void CollectDriftedQueries(int document_count, std::set<int>& query_ids) const;
+
+    std::optional<double> ComputeInverseDocumentFreq(std::string_view word) const;
+
+    const SearchServer& search_server_;
+    const ResultsCallback callback_;
+    const double max_idf_drift_;
+
+    int next_query_id_ = 0;
+    size_t evaluation_count_ = 0;
+    std::map<int, StandingQuery> queries_;
+    std::map<std::string, std::vector<int>, std::less<>> plus_word_to_queries_;
+    std::map<std::string, std::vector<int>, std::less<>> minus_word_to_queries_;
+    std::map<int, std::set<int>> document_to_queries_; // result documents
+    std::multimap<double, int> min_document_counts_;
+    std::multimap<double, int> max_document_counts_;
+};
@@ -1,15 +1,57 @@
 #include "string_processing.h"
 
-std::vector<std::string_view> SplitIntoWords(std::string_view text) {
-    std::vector<std::string_view> words;
-    text.remove_prefix(std::min(text.size(), text.find_first_not_of(" ")));
-    const int64_t pos_end = text.npos;
+#include <algorithm>
+
+namespace {
 
-    while (!text.empty()) {
-        int64_t space = text.find(' ');
-        words.push_back(space == pos_end ? text.substr(0) : text.substr(0, space));
-        text.remove_prefix(std::min(text.size(), text.find_first_not_of(" ", space)));
+    template <typename Words>
+    void AppendWords(std::string_view text, Words& words) {
+        text.remove_prefix(std::min(text.size(), text.find_first_not_of(" ")));
+        const int64_t pos_end = text.npos;
+
+        while (!text.empty()) {
+            int64_t space = text.find(' ');
+            words.push_back(space == pos_end ? text.substr(0) : text.substr(0, space));
+            text.remove_prefix(std::min(text.size(), text.find_first_not_of(" ", space)));
+        }
     }
+}
+
+std::vector<std::string_view> SplitIntoWords(std::string_view text) {
+    std::vector<std::string_view> words;
+    AppendWords(text, words);
+    return words;
+}
 
+std::pmr::vector<std::string_view> SplitIntoWords(std::string_view text, std::pmr::memory_resource* resource) {
+    std::pmr::vector<std::string_view> words(resource);
+    AppendWords(text, words);
     return words;
 }
+
+bool IsValidWord(std::string_view word) {
+    return std::none_of(word.begin(), word.end(), [](char c) {
+        return c >= '\0' && c < ' ';
+        });
+}
+
+QueryWord ParseQueryWord(std::string_view text) {
+    if (text.empty()) {
+        throw std::invalid_argument("Query word is empty"s);
+    }
+    std::string_view word = text;
+    bool is_minus = false;
+    if (word[0] == '-') {
+        is_minus = true;
+        word = word.substr(1);
+    }
+    bool is_prefix = false;
+    if (word.size() > 1 && word.back() == '*') {
+        is_prefix = true;
+        word.remove_suffix(1);
+    }
+    if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
+        throw std::invalid_argument("Query word is invalid"s);
+    }
+    return { word, is_minus, is_prefix };
+}
@@ -1,6 +1,47 @@
 #pragma once
+#include <memory_resource>
+#include <stdexcept>
+#include <string>
 #include <string_view>
 #include <vector>
 
+using namespace std::string_literals;
 
-std::vector<std::string_view> SplitIntoWords(std::string_view text);
\ No newline at end of file
+std::vector<std::string_view> SplitIntoWords(std::string_view text);
+
+// The same words in a vector allocated from resource
+std::pmr::vector<std::string_view> SplitIntoWords(std::string_view text, std::pmr::memory_resource* resource);
+
+// A valid word must not contain special characters
+bool IsValidWord(std::string_view word);
+
+// Adds the words to a set of stop words, throws std::invalid_argument on an invalid one
+template <typename StringCollection, typename StopWords>
+void AddStopWords(const StringCollection& words, StopWords& stop_words) {
+    for (std::string_view word : words) {
+        if (!IsValidWord(word)) {
+            throw std::invalid_argument("Stop-words contain invalid characters"s);
+        }
+        stop_words.emplace(word);
+    }
+}
+
+template <typename StopWords>
+std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text, const StopWords& stop_words) {
+    std::vector<std::string_view> words;
+    for (std::string_view word : SplitIntoWords(text)) {
+        if (stop_words.count(word) == 0) {
+            words.push_back(word);
+        }
+    }
+    return words;
+}
+
+struct QueryWord {
+    std::string_view data;
+    bool is_minus;
+    bool is_prefix; // "word*" matches every indexed word starting with data
+};
+
+// Strips the minus and the prefix asterisk, throws std::invalid_argument on an empty or invalid word
+QueryWord ParseQueryWord(std::string_view text);
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "term_dictionary.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+namespace {
+
+    size_t GetCommonPrefixSize(std::string_view lhs, std::string_view rhs) {
+        size_t size = 0;
+        while (size < lhs.size() && size < rhs.size() && lhs[size] == rhs[size]) {
+            ++size;
+        }
+        return size;
+    }
+}
+
+size_t TermDictionary::GetTermCount() const {
+    return term_count_;
+}
+
+int TermDictionary::FindTerm(std::string_view term) const {
+    if (term_count_ == 0) {
+        return -1;
+    }
+    const size_t block = FindBlock(term);
+    if (block + 1 < block_offsets_.size() && GetBlockFirstTerm(block + 1) == term) {
+        return static_cast<int>((block + 1) * BLOCK_SIZE);
+    }
+
+    // The block is scanned without decoding: matched is the prefix the previous term shares with
+    // term, and a following term is compared only when it keeps exactly that prefix
+    const std::string_view data = data_;
+    size_t position = block_offsets_[block];
+    const size_t first_size = ReadVarint(data_, position);
+    const std::string_view first = data.substr(position, first_size);
+    position += first_size;
+    if (first == term) {
+        return static_cast<int>(block * BLOCK_SIZE);
+    }
+    if (first > term) {
+        return -1;
+    }
+    size_t matched = GetCommonPrefixSize(first, term);
+
+    const size_t end = std::min(term_count_, (block + 1) * BLOCK_SIZE);
+    for (size_t ordinal = block * BLOCK_SIZE + 1; ordinal < end; ++ordinal) {
+        const size_t shared = ReadVarint(data_, position);
+        const size_t suffix_size = ReadVarint(data_, position);
+        const std::string_view suffix = data.substr(position, suffix_size);
+        position += suffix_size;
+        if (shared > matched) {
+            // Differs from term where the previous term did, so it is still less
+            continue;
+        }
+        if (shared < matched) {
+            return -1;
+        }
+        const std::string_view rest = term.substr(matched);
+        if (suffix == rest) {
+            return static_cast<int>(ordinal);
+        }
+        if (suffix > rest) {
+            return -1;
+        }
+        matched += GetCommonPrefixSize(suffix, rest);
+    }
+    return -1;
+}
+
+std::string TermDictionary::GetTerm(int ordinal) const {
+    if (ordinal < 0 || static_cast<size_t>(ordinal) >= term_count_) {
+        throw std::out_of_range("The term ordinal is out of range"s);
+    }
+    Cursor cursor(*this, ordinal / BLOCK_SIZE);
+    while (cursor.GetOrdinal() != ordinal) {
+        cursor.Next();
+    }
+    return std::string(cursor.GetTerm());
+}
+
+size_t TermDictionary::GetMemoryUsage() const {
+    return sizeof(*this) + data_.capacity() + block_offsets_.capacity() * sizeof(uint32_t);
+}
+
+TermDictionary::Cursor::Cursor(const TermDictionary& dictionary, size_t block)
+    : dictionary_(dictionary)
+    , position_(block < dictionary.block_offsets_.size() ? dictionary.block_offsets_[block] : dictionary.data_.size())
+    , ordinal_(static_cast<int>(block * BLOCK_SIZE))
+{
+    if (IsValid()) {
+        ReadTerm();
+    }
+}
+
+bool TermDictionary::Cursor::IsValid() const {
+    return static_cast<size_t>(ordinal_) < dictionary_.term_count_;
+}
+
+void TermDictionary::Cursor::Next() {
+    ++ordinal_;
+    if (IsValid()) {
+        ReadTerm();
+    }
+}
+
+std::string_view TermDictionary::Cursor::GetTerm() const {
+    return term_;
+}
+
+int TermDictionary::Cursor::GetOrdinal() const {
+    return ordinal_;
+}
+
+void TermDictionary::Cursor::ReadTerm() {
+    const std::string& data = dictionary_.data_;
+    // The first term of a block is stored whole
+    const size_t shared = ordinal_ % BLOCK_SIZE == 0 ? 0 : ReadVarint(data, position_);
+    const size_t suffix_size = ReadVarint(data, position_);
+    term_.resize(shared);
+    term_.append(data, position_, suffix_size);
+    position_ += suffix_size;
+}
+
+void TermDictionary::AddTerm(std::string_view term, std::string_view previous) {
+    if (term_count_ % BLOCK_SIZE == 0) {
+        block_offsets_.push_back(static_cast<uint32_t>(data_.size()));
+        WriteVarint(data_, static_cast<uint32_t>(term.size()));
+        data_.append(term);
+    }
+    else {
+        const size_t shared = GetCommonPrefixSize(term, previous);
+        WriteVarint(data_, static_cast<uint32_t>(shared));
+        WriteVarint(data_, static_cast<uint32_t>(term.size() - shared));
+        data_.append(term.substr(shared));
+    }
+    ++term_count_;
+}
+
+std::string_view TermDictionary::GetBlockFirstTerm(size_t block) const {
+    size_t position = block_offsets_[block];
+    const size_t size = ReadVarint(data_, position);
+    return std::string_view(data_).substr(position, size);
+}
+
+size_t TermDictionary::FindBlock(std::string_view term) const {
+    size_t low = 0;
+    size_t high = block_offsets_.size();
+    while (high - low > 1) {
+        const size_t middle = low + (high - low) / 2;
+        if (GetBlockFirstTerm(middle) < term) {
+            low = middle;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+void TermDictionary::WriteVarint(std::string& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+uint32_t TermDictionary::ReadVarint(const std::string& data, size_t& position) {
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        const uint8_t byte = static_cast<uint8_t>(data[position++]);
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+}
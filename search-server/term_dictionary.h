@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Immutable sorted set of terms stored with front coding: every block of BLOCK_SIZE terms keeps
+// its first term whole and each following term as the length of the prefix shared with the
+// previous term plus the remaining suffix. Terms are numbered 0..N-1 in sorted order.
+class TermDictionary {
+public:
+    static const size_t BLOCK_SIZE = 16;
+
+    TermDictionary() = default;
+
+    // Terms must be sorted and unique
+    template <typename Iterator>
+    TermDictionary(Iterator begin, Iterator end);
+
+    size_t GetTermCount() const;
+
+    // Ordinal of the term or -1
+    int FindTerm(std::string_view term) const;
+
+    std::string GetTerm(int ordinal) const;
+
+    // Calls callback(term, ordinal) for every term that starts with prefix, in sorted order
+    template <typename Callback>
+    void ForEachWithPrefix(std::string_view prefix, Callback callback) const;
+
+    // Bytes held by the dictionary
+    size_t GetMemoryUsage() const;
+
+private:
+    // Decodes the terms of the dictionary one by one starting from a block
+    class Cursor {
+    public:
+        Cursor(const TermDictionary& dictionary, size_t block);
+
+        bool IsValid() const;
+        void Next();
+
+        std::string_view GetTerm() const;
+        int GetOrdinal() const;
+
+    private:
+        void ReadTerm();
+
+        const TermDictionary& dictionary_;
+        size_t position_;
+        int ordinal_;
+        std::string term_;
+    };
+
+    void AddTerm(std::string_view term, std::string_view previous);
+
+    std::string_view GetBlockFirstTerm(size_t block) const;
+
+    // Last block whose first term is less than term, or 0
+    size_t FindBlock(std::string_view term) const;
+
+    static void WriteVarint(std::string& out, uint32_t value);
+    static uint32_t ReadVarint(const std::string& data, size_t& position);
+
+    std::string data_;
+    std::vector<uint32_t> block_offsets_;
+    size_t term_count_ = 0;
+};
+
+template <typename Iterator>
+TermDictionary::TermDictionary(Iterator begin, Iterator end) {
+    std::string_view previous;
+    for (auto it = begin; it != end; ++it) {
+        const std::string_view term = *it;
+        AddTerm(term, previous);
+        previous = term;
+    }
+    data_.shrink_to_fit();
+    block_offsets_.shrink_to_fit();
+}
+
+template <typename Callback>
+void TermDictionary::ForEachWithPrefix(std::string_view prefix, Callback callback) const {
+    if (term_count_ == 0) {
+        return;
+    }
+    for (Cursor cursor(*this, FindBlock(prefix)); cursor.IsValid(); cursor.Next()) {
+        const std::string_view term = cursor.GetTerm();
+        if (term.substr(0, prefix.size()) == prefix) {
+            callback(term, cursor.GetOrdinal());
+        }
+        else if (term > prefix) {
+            return;
+        }
+    }
+}